@@ -56,7 +56,10 @@ static const uart_conf_t uart_config[] = {
 };
 
 #define UART_0_ISR (isr_usart2)
+#ifndef MODULE_EZOEC_DMA
 #define UART_1_ISR (isr_lpuart1)
+#endif
+/* With ezoec_dma, LPUART1 receives by DMA and modules/ezoec owns its IRQ. */
 
 #define UART_NUMOF ARRAY_SIZE(uart_config)
 /** @} */
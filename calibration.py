@@ -1,12 +1,9 @@
-import numpy as np
-from scipy.stats import linregress
-import matplotlib.pyplot as plt
-
-# Temperature (°C) and corresponding conductivity (µS/cm) values from the table
-t_low = np.array([5, 10, 15, 20, 25, 30, 35, 40, 45, 50])  # °C
-c_low = np.array([8220, 9330, 10480, 11670, 12880, 14120, 15550, 16880, 18210, 19550])  # µS/cm
-t_high = np.array([5, 10, 15, 20, 25, 30, 35, 40, 45, 50])  # °C
-c_high = np.array([53500, 59600, 65400, 72400, 80000, 88200, 96400, 104600, 112800, 121000])  # µS/cm
+# Temperature (°C) and corresponding conductivity (µS/cm) values from the table.
+# Plain lists, modules/ezoec/gen_tc_lut.py imports them without numpy.
+t_low = [5, 10, 15, 20, 25, 30, 35, 40, 45, 50]  # °C
+c_low = [8220, 9330, 10480, 11670, 12880, 14120, 15550, 16880, 18210, 19550]  # µS/cm
+t_high = [5, 10, 15, 20, 25, 30, 35, 40, 45, 50]  # °C
+c_high = [53500, 59600, 65400, 72400, 80000, 88200, 96400, 104600, 112800, 121000]  # µS/cm
 
 
 def create_linear_formula(t, c):
@@ -36,7 +33,8 @@ def plot_formula(t, c, formula, title=None):
     # Labels and title
     plt.xlabel('Temperature (°C)')
     plt.ylabel('Conductivity (µS/cm)')
-    plt.title(f'Extrapolated Temperature vs Conductivity{"\n" + title}\n{str(formula)} ; Error={offsets:.0f}')
+    subtitle = "" if title is None else "\n" + title
+    plt.title(f'Extrapolated Temperature vs Conductivity{subtitle}\n{str(formula)} ; Error={offsets:.0f}')
     plt.legend()
     plt.grid(True)
     plt.tight_layout()
@@ -51,32 +49,37 @@ def calculate_off(t, c, formula):
     return np.mean(np.sqrt(np.power((c_cal - c), 2)))
 
 
-# lin_low = create_linear_formula(t_low, c_low)
-# plot_formula(t_low, c_low, lin_low, "Calibration Extrapolation Linear Low")
+if __name__ == "__main__":
+    import numpy as np
+    from scipy.stats import linregress
+    import matplotlib.pyplot as plt
+
+    # lin_low = create_linear_formula(t_low, c_low)
+    # plot_formula(t_low, c_low, lin_low, "Calibration Extrapolation Linear Low")
 
-# lin_high = create_linear_formula(t_high, c_high)
-# plot_formula(t_high, c_high, lin_high, "Calibration Extrapolation Linear High")
+    # lin_high = create_linear_formula(t_high, c_high)
+    # plot_formula(t_high, c_high, lin_high, "Calibration Extrapolation Linear High")
 
-poly_low, orders_low = create_poly_formula(t_low, c_low, 3)
-# plot_formula(t_low, c_low, poly_low, "Calibration Extrapolation Poly Low")
+    poly_low, orders_low = create_poly_formula(t_low, c_low, 3)
+    # plot_formula(t_low, c_low, poly_low, "Calibration Extrapolation Poly Low")
 
-poly_high, orders_high = create_poly_formula(t_high, c_high, 3)
-# plot_formula(t_high, c_high, poly_high, "Calibration Extrapolation Poly High")
+    poly_high, orders_high = create_poly_formula(t_high, c_high, 3)
+    # plot_formula(t_high, c_high, poly_high, "Calibration Extrapolation Poly High")
 
-temps = np.arange(0,30.1, 0.1)
-lows = poly_low(temps)
-highs = poly_high(temps)
+    temps = np.arange(0,30.1, 0.1)
+    lows = poly_low(temps)
+    highs = poly_high(temps)
 
-with open("calibrations.csv", "w") as file:
-    import csv
-    writer = csv.writer(file)
-    writer.writerow(["Temperature", "Low uS", "High uS"])
-    for i in range(len(temps)):
-        writer.writerow([
-            f"{temps[i]:.3f}",
-            f"{lows[i]:.3f}",
-            f"{highs[i]:.3f}",
-        ])
+    with open("calibrations.csv", "w") as file:
+        import csv
+        writer = csv.writer(file)
+        writer.writerow(["Temperature", "Low uS", "High uS"])
+        for i in range(len(temps)):
+            writer.writerow([
+                f"{temps[i]:.3f}",
+                f"{lows[i]:.3f}",
+                f"{highs[i]:.3f}",
+            ])
 
-# temp = 23.2
-# print(poly_low(temp), poly_high(temp))
+    # temp = 23.2
+    # print(poly_low(temp), poly_high(temp))
@@ -4,15 +4,19 @@
 #include "ezoec.h"
 #include <stdint.h>
 
-#define CFG_FLAG_A_CALIBRATED (1 << 0)
-#define CFG_FLAG_B_CALIBRATED (1 << 1)
-#define CFG_MAGIC_HEADER      "MFM01"
+#define CFG_FLAG_A_CALIBRATED  (1 << 0)
+#define CFG_FLAG_B_CALIBRATED  (1 << 1)
+#define CFG_FLAG_FW_CORRECTION (1 << 2) // EZO keeps one reference calibration, probes are corrected in firmware
+#define CFG_FLAG_STREAMING     (1 << 3) // Boost stays on, the EZO streams readings (C,1)
+#define CFG_FLAG_FW_TEMP_COMP  (1 << 4) // Readings are taken at RT,25 and normalised to 25 C in firmware
+#define CFG_MAGIC_HEADER       "MFM01"
 
 typedef struct {
     char magic[6];
     uint8_t flags;
     ezoec_calibration_t calibration[2];
     uint8_t k_values[2];
+    ezoec_correction_t correction[2];
 } eeprom_config_t;
 extern eeprom_config_t eeprom_config;
 
@@ -24,6 +28,9 @@ int config_init(void);
 int config_clear(void);
 int config_persist(void);
 int config_has_calibration(uint8_t probe);
+int config_uses_correction(void);
+int config_streams(void);
+int config_compensates_in_fw(void);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -2,17 +2,23 @@
 #include "config.h"
 #include "ds18_local.h"
 #include "ezoec.h"
+#include "ezoec_async.h"
+#include "ezoec_tc.h"
 #include "mfm_comm.h"
 #include "msg.h"
-#include "periph/cpu_gpio.h"
 #include "periph/eeprom.h"
 #include "periph/gpio.h"
 #include "periph/uart.h"
 #include "irq.h"
 #include "sched.h"
 #include "shell.h"
-#include "stm32l010x6.h"
 #include "thread.h"
+#ifdef CPU_NATIVE
+#include "mfm_sim.h"
+#else
+#include "periph/cpu_gpio.h"
+#include "stm32l010x6.h"
+#endif
 #include <inttypes.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -31,8 +37,8 @@
 // Variables
 // ==================================
 static ezoec_t ec                     = {0};
-static ds18_t t1                      = {0};
-static ds18_t t2                      = {0};
+static ds18_t t1                      = {.resolution = DS18_RESOLUTION_MAX}; // Power-up default until init
+static ds18_t t2                      = {.resolution = DS18_RESOLUTION_MAX};
 static const ezoec_params_t ec_params = {
     .baud_rate = 115200,
     .uart      = UART_DEV(1),
@@ -45,6 +51,9 @@ static const ds18_params_t t2_params = {
     .pin      = DQ_B_PIN,
     .out_mode = GPIO_OD_PU,
 };
+#ifndef CONFIG_TEMP_RESOLUTION
+#define CONFIG_TEMP_RESOLUTION 10 // DS18B20 bits, 10 bit is 0.25 C in 188 ms
+#endif
 
 typedef enum {
     PROBE_A,
@@ -84,6 +93,31 @@ typedef enum APP_ERROR {
     ERR_TEMP_B_READ    = (1 << 6), // Temperature B read failed
 } APP_ERROR;
 
+// ==================================
+// Phase timing (durations of the last measurement cycle)
+// ==================================
+typedef enum {
+    PHASE_WARMUP,
+    PHASE_INIT,
+    PHASE_TRIGGER,
+    PHASE_CONDUCTIVITY_A,
+    PHASE_CONDUCTIVITY_B,
+    PHASE_TEMPERATURE,
+    PHASE_TOTAL,
+    PHASE_NUMOF,
+} phase_t;
+
+static const char *const phase_names[PHASE_NUMOF] = {
+    "warmup", "init", "trigger", "cond A", "cond B", "temp", "total",
+};
+static uint32_t phase_ms[PHASE_NUMOF] = {0};
+
+static uint32_t phase_mark(phase_t phase, uint32_t since) {
+    uint32_t now    = ztimer_now(ZTIMER_MSEC);
+    phase_ms[phase] = now - since;
+    return now;
+}
+
 // ==================================
 // MSG Commands
 // ==================================
@@ -92,6 +126,10 @@ typedef enum APP_MSG {
     MSG_MFR_INIT,
     MSG_DO_MEASURE,
     MSG_CLEAR_BOOT_MAGIC,
+    MSG_MEAS_STEP,
+    MSG_STREAM_READING,  // Streamed EZO reading, content.value in nS
+    MSG_STREAM_SWITCH,   // (Re)try selecting stream.probe
+    MSG_STREAM_SWITCHED, // Probe switch done on the EZO worker
 } APP_MSG;
 
 // ==================================
@@ -100,6 +138,7 @@ typedef enum APP_MSG {
 
 static int mfm_comm_sensor_init(void *arg);
 static int mfm_comm_perform_measurement(void *arg);
+static uint16_t mfm_comm_measurement_time(void *arg);
 static const mfm_comm_params_t mfm_comm_params = {
     .firmware_version       = FW_VERSION,
     .module_type            = 0xFF,
@@ -107,6 +146,7 @@ static const mfm_comm_params_t mfm_comm_params = {
     .sensor_count           = 1,
     .sensor_init_fn         = &mfm_comm_sensor_init,
     .perform_measurement_fn = &mfm_comm_perform_measurement,
+    .measurement_time_fn    = &mfm_comm_measurement_time,
 };
 static mfm_comm_t mfm_comm;
 
@@ -165,6 +205,12 @@ int config_has_calibration(uint8_t probe) {
     return -EINVAL;
 }
 
+int config_uses_correction(void) { return (eeprom_config.flags & CFG_FLAG_FW_CORRECTION) > 0; }
+
+int config_streams(void) { return (eeprom_config.flags & CFG_FLAG_STREAMING) > 0; }
+
+int config_compensates_in_fw(void) { return (eeprom_config.flags & CFG_FLAG_FW_TEMP_COMP) > 0; }
+
 int config_init(void) {
     eeprom_read(0, &eeprom_config, sizeof(eeprom_config));
     if (strcmp(eeprom_config.magic, CFG_MAGIC_HEADER) != 0) {
@@ -193,35 +239,80 @@ int config_persist(void) { return eeprom_write(0, &eeprom_config, sizeof(eeprom_
 // Functions
 // ==================================
 
-int sensors_init(void) {
-    int result = ezoec_init(&ec, &ec_params);
+int sensors_init_conductivity(void) {
+    int result = ezoec_resume(&ec, &ec_params);
     if (result < 0) {
         printf("EZOEC Initialization error: %d\n", result);
         return -1;
     }
+    return 0;
+}
 
-    result = ds18_init(&t1, &t1_params);
-    if (result < 0) {
-        printf("DS18B20 A Initialization error: %d\n", result);
-        return -1;
-    }
+// Both probes at once, in masks of PROBE_BIT(probe). With both wanted the DS18
+// buses run in lockstep (ds18_multi_*), so the pair costs the bus time of one.
+#define PROBE_BIT(probe) (1 << (probe))
+#define PROBES_ALL       (PROBE_BIT(PROBE_A) | PROBE_BIT(PROBE_B))
+
+static ds18_t *const temp_buses[] = {&t1, &t2}; // Indexed by probe_t
+
+// Buses due a ROM search, as a PROBE_BIT() mask. All of them at boot, later
+// only after a trigger, read or resolution write failed on the bus.
+static uint8_t temp_search = PROBES_ALL;
+
+// Has the next sensors_init_temperature() search the @p probes buses again
+static void sensors_temperature_lost(uint8_t probes) { temp_search |= probes; }
+
+int sensors_init_temperature(void) {
+    for (probe_t probe = PROBE_A; probe <= PROBE_B; probe++) {
+        ds18_t *t = temp_buses[probe];
+        if (temp_search & PROBE_BIT(probe)) {
+            // The search runs with IRQs masked, about 13 ms per bus
+            int result = ds18_init(t, probe == PROBE_B ? &t2_params : &t1_params);
+            if (result < 0) {
+                printf("DS18B20 %c Initialization error: %d\n", 'A' + probe, result);
+                return -1;
+            }
+            // A failed search leaves the bus on SKIP ROM, fine for a single sensor
+            if (ds18_search(t) < 0) {
+                DEBUG("DS18B20 %c ROM search failed\n", 'A' + probe);
+            }
+            temp_search &= ~PROBE_BIT(probe);
+        }
 
-    result = ds18_init(&t2, &t2_params);
-    if (result < 0) {
-        printf("DS18B20 B Initialization error: %d\n", result);
-        return -1;
+        // Not persisted, the sensors come back at 12 bit after a power cycle. A
+        // bus without sensor fails here: it stays at 12 bit and its trigger and
+        // read set the ERR_TEMP_x flags, the other probe goes on as usual.
+        if (ds18_set_resolution(t, CONFIG_TEMP_RESOLUTION, 0) < 0) {
+            DEBUG("DS18B20 %c resolution failed\n", 'A' + probe);
+            t->resolution = DS18_RESOLUTION_MAX;
+            sensors_temperature_lost(PROBE_BIT(probe));
+        }
     }
 
     return 0;
 }
 
+int sensors_init(void) {
+    int result = sensors_init_conductivity();
+    if (result < 0) {
+        return result;
+    }
+    return sensors_init_temperature();
+}
+
 void sensors_enable(void) {
     gpio_init(BOOST_EN_PIN, GPIO_OUT);
     gpio_set(BOOST_EN_PIN);
+#if IS_USED(MODULE_MFM_SIM)
+    mfm_sim_boost(1);
+#endif
 }
 void sensors_disable(void) {
     gpio_clear(BOOST_EN_PIN);
     gpio_init(BOOST_EN_PIN, GPIO_IN);
+#if IS_USED(MODULE_MFM_SIM)
+    mfm_sim_boost(0);
+#endif
 }
 
 int sensors_trigger_temperature(probe_t probe) {
@@ -235,31 +326,115 @@ int sensors_trigger_temperature(probe_t probe) {
     }
     return 0;
 }
+// 1 while the conversion of a probe's bus runs, only valid right after the trigger
+int sensors_temperature_converting(probe_t probe) {
+    return ds18_is_converting(probe == PROBE_B ? &t2 : &t1);
+}
 int sensors_get_temperature(probe_t probe, int16_t *out) {
     ds18_t *t = &t1;
     if (probe == PROBE_B) {
         t = &t2;
     }
-    *out       = 0;
-    int result = ds18_read(t, out);
-    if (result < 0) {
-        return result;
+    *out = 0;
+
+    // All sensors of the bus converted on the one trigger, report their mean
+    int16_t temperatures[CONFIG_DS18_MAX_DEVICES];
+    int count = ds18_read_all(t, temperatures);
+    if (count < 0) {
+        return count;
+    }
+    int32_t sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += temperatures[i];
     }
+    *out = sum / count;
     return 0;
 }
 
+// Worst case conversion time of the probes' buses, each at its own resolution
+uint32_t sensors_temperature_convert_ms(uint8_t probes) {
+    uint32_t ms = 0;
+    for (probe_t probe = PROBE_A; probe <= PROBE_B; probe++) {
+        if ((probes & PROBE_BIT(probe)) && ds18_conversion_ms(temp_buses[probe]) > ms) {
+            ms = ds18_conversion_ms(temp_buses[probe]);
+        }
+    }
+    return ms;
+}
+
+// Returns the probes whose trigger failed
+int sensors_trigger_temperatures(uint8_t probes) {
+    if (probes == PROBES_ALL) {
+        int failed = ds18_multi_trigger(temp_buses, 2);
+        return failed < 0 ? PROBES_ALL : failed;
+    }
+    int failed = 0;
+    for (probe_t probe = PROBE_A; probe <= PROBE_B; probe++) {
+        if ((probes & PROBE_BIT(probe)) && sensors_trigger_temperature(probe) < 0) {
+            failed |= PROBE_BIT(probe);
+        }
+    }
+    return failed;
+}
+// Returns the probes whose conversion still runs, only valid right after the trigger
+int sensors_temperatures_converting(uint8_t probes) {
+    if (probes == PROBES_ALL) {
+        int converting = ds18_multi_converting(temp_buses, 2);
+        return converting < 0 ? 0 : converting;
+    }
+    int converting = 0;
+    for (probe_t probe = PROBE_A; probe <= PROBE_B; probe++) {
+        if ((probes & PROBE_BIT(probe)) && sensors_temperature_converting(probe) > 0) {
+            converting |= PROBE_BIT(probe);
+        }
+    }
+    return converting;
+}
+// Reads into out[probe], returns the probes that failed
+int sensors_get_temperatures(uint8_t probes, int16_t *out) {
+    out[PROBE_A] = 0;
+    out[PROBE_B] = 0;
+
+    // The parallel read takes one sensor per bus, several are averaged bus by bus
+    if (probes == PROBES_ALL && t1.count <= 1 && t2.count <= 1) {
+        int failed = ds18_multi_read(temp_buses, 2, out);
+        return failed < 0 ? PROBES_ALL : failed;
+    }
+    int failed = 0;
+    for (probe_t probe = PROBE_A; probe <= PROBE_B; probe++) {
+        if ((probes & PROBE_BIT(probe)) && sensors_get_temperature(probe, &out[probe]) < 0) {
+            failed |= PROBE_BIT(probe);
+        }
+    }
+    return failed;
+}
+
 static int switch_probe(uint8_t index) {
     gpio_write(PRB_SEL_PIN, index);
+#if IS_USED(MODULE_MFM_SIM)
+    mfm_sim_probe_select(index);
+#endif
     return 0;
 }
 
-int sensors_get_conductivity(probe_t probe, uint32_t *out) {
+/**
+ * @brief Connects a probe to the EZO and loads its K value and calibration,
+ * unless the EZO keeps one reference calibration (firmware correction).
+ *
+ * Runs on the EZO worker and stays silent, see sensors_warn_probe().
+ */
+int sensors_select_probe(probe_t probe) {
     int result;
-    *out = 0;
 
     // Switch probe
     switch_probe(probe);
 
+    // The EZO holds one reference calibration for both probes, all that is
+    // left is to read and correct.
+    if (config_uses_correction()) {
+        return 0;
+    }
+
     // Set probe K
     uint8_t k = eeprom_config.k_values[probe];
     if (k > 0) {
@@ -267,99 +442,823 @@ int sensors_get_conductivity(probe_t probe, uint32_t *out) {
         if (result < 0) {
             return result;
         }
-    } else {
-        printf("Warning: probe %c has no K value set\n", probe == PROBE_A ? 'A' : 'B');
     }
 
-    // Load calibration into ezoec
+    // Load calibration into ezoec, skipped when the EZO already holds it
     if (config_has_calibration(probe)) {
-        result = ezoec_cal_import(&ec, &eeprom_config.calibration[probe]);
+        result = ezoec_cal_load(&ec, &eeprom_config.calibration[probe]);
         if (result < 0) {
             return result;
         }
-        // TODO: Add justification for 1s delay.
-        ztimer_sleep(ZTIMER_MSEC, 1000);
-    } else {
-        printf("Warning: probe %c has no calibration\n", probe == PROBE_A ? 'A' : 'B');
+        if (result > 0) {
+            // The EZO resets after Import, give it time to settle after *RE
+            // before the next command
+            ztimer_sleep(ZTIMER_MSEC, 1000);
+        }
+    }
+    return 0;
+}
+
+// Warns about what sensors_select_probe() will skip, printed by the thread
+// that queues the selection.
+static void sensors_warn_probe(probe_t probe) {
+    char name = (probe == PROBE_A) ? 'A' : 'B';
+    if (!config_has_calibration(probe)) {
+        printf("Warning: probe %c has no calibration\n", name);
+    }
+    if (!config_uses_correction() && eeprom_config.k_values[probe] == 0) {
+        printf("Warning: probe %c has no K value set\n", name);
+    }
+}
+
+// Applies the firmware correction of a probe to a raw EZO reading, if used.
+static uint32_t sensors_correct(probe_t probe, uint32_t raw_nS) {
+    if (config_uses_correction() && config_has_calibration(probe)) {
+        return ezoec_correct(&eeprom_config.correction[probe], raw_nS);
+    }
+    return raw_nS;
+}
+
+#define MEAS_MAX_SAMPLES 16 // Cap of REG_MEAS_SAMPLES
+#ifndef CONFIG_MEAS_SAMPLE_TOLERANCE_PERMILLE
+#define CONFIG_MEAS_SAMPLE_TOLERANCE_PERMILLE 5 // Oversampling stops once max - min is within this of the median
+#endif
+#define MEAS_SAMPLES_EARLY_STOP 3 // Readings needed before the spread is judged
+
+/**
+ * @brief Reads a probe up to @p samples times back to back and reduces the
+ * readings to their interquartile mean (the median for 3 or 4 readings).
+ *
+ * Stops early once the spread (max - min) is within
+ * CONFIG_MEAS_SAMPLE_TOLERANCE_PERMILLE of the median. Relative unlike the
+ * absolute uS tolerance of wait_for_stable_readings(), so it holds over the
+ * whole range of the probe.
+ *
+ * @param centi_C Temperature to compensate for (RT), NULL for plain R. With
+ * CFG_FLAG_FW_TEMP_COMP the EZO is told 25 C and the corrected value is
+ * normalised with ezoec_tc_normalise() instead.
+ *
+ * @return Number of readings taken, negative on error.
+ */
+int sensors_sample_conductivity(probe_t probe, uint8_t samples, const int16_t *centi_C, uint32_t *out) {
+    static const int16_t ezo_reference_cC = 2500;
+    uint32_t readings[MEAS_MAX_SAMPLES];
+    const int16_t *ezo_cC = centi_C;
+    if (centi_C != NULL && config_compensates_in_fw()) {
+        ezo_cC = &ezo_reference_cC;
+    }
+    *out = 0;
+    if (samples == 0) {
+        samples = 1;
+    } else if (samples > MEAS_MAX_SAMPLES) {
+        samples = MEAS_MAX_SAMPLES;
     }
 
-    result = ezoec_measure(&ec, out);
+    int result = sensors_select_probe(probe);
     if (result < 0) {
-        *out = 0;
         return result;
     }
 
+    uint8_t taken = 0;
+    while (taken < samples) {
+        uint32_t raw = 0;
+        if (ezo_cC != NULL) {
+            result = ezoec_measure_compensated(&ec, *ezo_cC, &raw);
+        } else {
+            result = ezoec_measure(&ec, &raw);
+        }
+        if (result < 0) {
+            return result;
+        }
+
+        // Insertion sort, the readings stay ordered
+        uint8_t i = taken++;
+        while (i > 0 && readings[i - 1] > raw) {
+            readings[i] = readings[i - 1];
+            i--;
+        }
+        readings[i] = raw;
+
+        if (taken >= MEAS_SAMPLES_EARLY_STOP) {
+            uint64_t tolerance = (uint64_t)readings[taken / 2] * CONFIG_MEAS_SAMPLE_TOLERANCE_PERMILLE / 1000;
+            if (readings[taken - 1] - readings[0] <= tolerance) {
+                break;
+            }
+        }
+    }
+
+    uint8_t trim = (taken + 1) / 4;
+    uint64_t sum = 0;
+    for (uint8_t i = trim; i < taken - trim; i++) {
+        sum += readings[i];
+    }
+    // The correction is monotonic, so it can be applied after reducing
+    *out = sensors_correct(probe, sum / (taken - 2 * trim));
+    if (ezo_cC != centi_C) {
+        *out = ezoec_tc_normalise(*out, *centi_C);
+    }
+    return taken;
+}
+
+// ==================================
+// Streaming
+// ==================================
+// With CFG_FLAG_STREAMING the boost stays on and the EZO runs in continuous
+// mode (C,1), sending a reading about once a second. The EZO worker forwards
+// them as msgs and each one updates a rolling value of the selected probe, so
+// measurement requests are answered without a fresh R. With two calibrated
+// probes the stream alternates between them.
+
+#ifndef CONFIG_MEAS_WARMUP_MAX_MS
+#define CONFIG_MEAS_WARMUP_MAX_MS 2000 // Give up waiting for the EZO banner after this
+#endif
+#ifndef CONFIG_STREAM_PROBE_READINGS
+#define CONFIG_STREAM_PROBE_READINGS 5 // Readings per probe before switching to the other
+#endif
+#ifndef CONFIG_STREAM_MAX_AGE_MS
+#define CONFIG_STREAM_MAX_AGE_MS 15000 // Older rolling values are reported as errors
+#endif
+#define STREAM_FILTER_SHIFT    2    // Exponential moving average, alpha = 1/4
+#define STREAM_SETTLE_READINGS 1    // Dropped after a probe switch
+#define STREAM_RETRY_MS        1000 // Retry delay of a failed probe switch
+
+typedef struct {
+    uint32_t value_nS;
+    uint32_t updated; // ztimer_now(ZTIMER_MSEC) of the last reading
+    uint16_t samples;
+} stream_filter_t;
+
+static struct {
+    uint8_t active;
+    probe_t probe;  // Probe the EZO is streaming
+    uint8_t skip;   // Readings left to drop after the switch
+    uint16_t count; // Readings taken of this probe since the switch
+    stream_filter_t filter[2];
+    ezoec_req_t req; // Probe switch on the EZO worker
+    ztimer_t retry_timer;
+    msg_t retry_msg;
+} stream = {
+    .retry_msg = {.type = MSG_STREAM_SWITCH},
+};
+
+static void stream_filter_add(stream_filter_t *f, uint32_t nS) {
+    if (f->samples == 0) {
+        f->value_nS = nS;
+    } else {
+        f->value_nS += ((int32_t)(nS - f->value_nS)) >> STREAM_FILTER_SHIFT;
+    }
+    if (f->samples < UINT16_MAX) {
+        f->samples++;
+    }
+    f->updated = ztimer_now(ZTIMER_MSEC);
+}
+
+/**
+ * @brief Rolling conductivity of a probe, if it is recent enough.
+ *
+ * @return 0 on success, -ENODATA if there is no recent value.
+ */
+static int stream_value(probe_t probe, uint32_t *out) {
+    stream_filter_t *f = &stream.filter[probe];
+    if (!stream.active || f->samples == 0 || ztimer_now(ZTIMER_MSEC) - f->updated > CONFIG_STREAM_MAX_AGE_MS) {
+        return -ENODATA;
+    }
+    *out = f->value_nS;
     return 0;
 }
 
-static int perform_measurement(measurement_t *m, uint8_t *error_flags) {
-    *error_flags = ERR_NONE;
-    memset(m, 0, sizeof(*m));
+// Runs on the EZO worker: the stream is paused while the probe's K value and
+// calibration are loaded.
+static int stream_switch_op(ezoec_t *dev, ezoec_req_t *req) {
+    int result = ezoec_stream(dev, 0);
+    if (result < 0) {
+        return result;
+    }
+    result = sensors_select_probe((probe_t)(uintptr_t)req->arg);
+    if (result < 0) {
+        return result;
+    }
+    return ezoec_stream(dev, 1);
+}
+
+static void stream_switch(probe_t probe) {
+    stream.probe = probe;
+    stream.count = 0;
+    stream.skip  = STREAM_SETTLE_READINGS;
+
+    sensors_warn_probe(probe);
+    ezoec_req_t *req = &stream.req;
+    req->op          = stream_switch_op;
+    req->arg         = (void *)(uintptr_t)probe;
+    req->target      = main_thread_pid;
+    req->msg_type    = MSG_STREAM_SWITCHED;
+    int result       = ezoec_async_submit(&ec, req);
+    if (result < 0) {
+        DEBUG("ERR(%d) stream switch\n", result);
+        ztimer_set_msg(ZTIMER_MSEC, &stream.retry_timer, STREAM_RETRY_MS, &stream.retry_msg, main_thread_pid);
+    }
+}
+
+static void stream_switched(void) {
+    if (stream.req.result < 0) {
+        printf("Stream probe %c error: %d\n", stream.probe == PROBE_A ? 'A' : 'B', stream.req.result);
+        ztimer_set_msg(ZTIMER_MSEC, &stream.retry_timer, STREAM_RETRY_MS, &stream.retry_msg, main_thread_pid);
+    }
+}
+
+static void stream_reading(uint32_t raw_nS) {
+    // Readings of the previous probe may still come in while switching
+    if (!stream.active || stream.req.result == -EINPROGRESS) {
+        return;
+    }
+    if (stream.skip > 0) {
+        stream.skip--;
+        return;
+    }
 
+    probe_t probe = stream.probe;
+    stream_filter_add(&stream.filter[probe], sensors_correct(probe, raw_nS));
+
+    probe_t other = (probe == PROBE_A) ? PROBE_B : PROBE_A;
+    if (++stream.count >= CONFIG_STREAM_PROBE_READINGS && config_has_calibration(other)) {
+        stream_switch(other);
+    }
+}
+
+/**
+ * @brief Powers the sensors and starts streaming. Blocks for the EZO warm-up.
+ */
+static int stream_start(void) {
+    if (stream.active) {
+        return 0;
+    }
+
+    int result = ezoec_open(&ec, &ec_params);
+    if (result < 0) {
+        return result;
+    }
     sensors_enable();
-    ztimer_sleep(ZTIMER_MSEC, 1000);
+    if (ezoec_wait_ready(&ec, CONFIG_MEAS_WARMUP_MAX_MS) < 0) {
+        ezoec_session_lost(&ec);
+    }
+    result = sensors_init();
+    if (result < 0) {
+        sensors_disable();
+        return result;
+    }
+    // Streamed values are normalised per cycle, see meas_normalise_stream()
+    if (config_compensates_in_fw()) {
+        result = ezoec_cmd(&ec, 0, NULL, 0, "T,%d", 25);
+        if (result < 0) {
+            sensors_disable();
+            return result;
+        }
+    }
 
-    int result = sensors_init();
+    result = ezoec_async_stream(&ec, main_thread_pid, MSG_STREAM_READING);
     if (result < 0) {
-        DEBUG("ERR(%d) sensors init\n", result);
         sensors_disable();
-        *error_flags |= ERR_SENSOR_INIT;
         return result;
     }
+    memset(stream.filter, 0, sizeof(stream.filter));
+    stream.active = 1;
+    stream_switch(config_has_calibration(PROBE_A) || !config_has_calibration(PROBE_B) ? PROBE_A : PROBE_B);
+    return 0;
+}
 
-    // Trigger temperature conversions first so they run in parallel with the
-    // (slower) EC measurement.
-    if (config_has_calibration(PROBE_A)) {
-        result = sensors_trigger_temperature(PROBE_A);
-        if (result < 0) {
-            DEBUG("ERR(%d) trigger temp A\n", result);
-            *error_flags |= ERR_TEMP_A_TRIGGER;
+static void app_handle_msg(msg_t *msg);
+
+/**
+ * @brief Stops streaming and powers the sensors down, servicing msgs while the
+ * EZO worker finishes.
+ */
+static int stream_stop(void) {
+    if (!stream.active) {
+        return 0;
+    }
+    stream.active = 0;
+    ztimer_remove(ZTIMER_MSEC, &stream.retry_timer);
+    ezoec_async_stream(&ec, KERNEL_PID_UNDEF, 0);
+
+    // The completion msg is dropped when the queue is full, poll the result
+    msg_t msg;
+    while (stream.req.result == -EINPROGRESS) {
+        if (msg_try_receive(&msg) == 1) {
+            app_handle_msg(&msg);
+        } else {
+            ztimer_sleep(ZTIMER_MSEC, 10);
         }
     }
-    if (config_has_calibration(PROBE_B)) {
-        result = sensors_trigger_temperature(PROBE_B);
-        if (result < 0) {
-            DEBUG("ERR(%d) trigger temp B\n", result);
-            *error_flags |= ERR_TEMP_B_TRIGGER;
+
+    int result = ezoec_stream(&ec, 0);
+    sensors_disable();
+    return result;
+}
+
+// ==================================
+// Measurement engine
+// ==================================
+// A measurement cycle is a sequence of steps, each run from the main msg loop
+// on a MSG_MEAS_STEP. Temperatures are read before the conductivities so the
+// EZO can compensate for them in the read itself (RT). Waits (boost warm-up, DS18 conversion) are ztimer msgs
+// and EZO reads run on the ezoec_async worker, which sends the MSG_MEAS_STEP
+// when done. Other msgs are serviced in between and repeated measure requests
+// are merged into the cycle in flight.
+
+#define MEAS_WARMUP_POLL_MS  50  // Slice of the warm-up wait, msgs are serviced in between
+#define MEAS_TEMP_POLL_MS    10
+
+// Distribution of the measured boost warm-up times, see the `warmup` command
+#define WARMUP_HIST_BIN_MS 100
+#define WARMUP_HIST_BINS   ((CONFIG_MEAS_WARMUP_MAX_MS / WARMUP_HIST_BIN_MS) + 1)
+static struct {
+    uint16_t bins[WARMUP_HIST_BINS]; // Last bin also holds the timeouts
+    uint16_t timeouts;
+    uint32_t min_ms;
+    uint32_t max_ms;
+} warmup_stats = {.min_ms = UINT32_MAX};
+
+static void warmup_record(uint32_t ms, int timed_out) {
+    unsigned bin = ms / WARMUP_HIST_BIN_MS;
+    if (bin >= WARMUP_HIST_BINS) {
+        bin = WARMUP_HIST_BINS - 1;
+    }
+    warmup_stats.bins[bin]++;
+    if (timed_out) {
+        warmup_stats.timeouts++;
+    }
+    if (ms < warmup_stats.min_ms) {
+        warmup_stats.min_ms = ms;
+    }
+    if (ms > warmup_stats.max_ms) {
+        warmup_stats.max_ms = ms;
+    }
+}
+
+// What a cycle measures, selected by the measurement type
+#define MEAS_EC_A   (1 << 0)
+#define MEAS_EC_B   (1 << 1)
+#define MEAS_TEMP_A (1 << 2)
+#define MEAS_TEMP_B (1 << 3)
+#define MEAS_EC     (MEAS_EC_A | MEAS_EC_B)
+#define MEAS_TEMP   (MEAS_TEMP_A | MEAS_TEMP_B)
+
+// Measurement types, written by the master to REG_MEAS_TYPE
+typedef enum {
+    MEAS_TYPE_FULL,         // Conductivity and temperature of both probes
+    MEAS_TYPE_TEMPERATURE,  // Temperatures only, the boost and EZO stay off
+    MEAS_TYPE_CONDUCTIVITY, // Conductivities only
+    MEAS_TYPE_PROBE_A,      // Conductivity and temperature of probe A
+    MEAS_TYPE_PROBE_B,      // Conductivity and temperature of probe B
+    MEAS_TYPE_NUMOF,
+} meas_type_t;
+
+static const uint8_t meas_type_content[MEAS_TYPE_NUMOF] = {
+    [MEAS_TYPE_FULL]         = MEAS_EC | MEAS_TEMP,
+    [MEAS_TYPE_TEMPERATURE]  = MEAS_TEMP,
+    [MEAS_TYPE_CONDUCTIVITY] = MEAS_EC,
+    [MEAS_TYPE_PROBE_A]      = MEAS_EC_A | MEAS_TEMP_A,
+    [MEAS_TYPE_PROBE_B]      = MEAS_EC_B | MEAS_TEMP_B,
+};
+
+/**
+ * @brief Parts a measurement type measures, limited to calibrated probes.
+ * Unknown types measure everything.
+ */
+static uint8_t meas_content(uint8_t type) {
+    uint8_t content = (type < MEAS_TYPE_NUMOF) ? meas_type_content[type] : meas_type_content[MEAS_TYPE_FULL];
+    if (!config_has_calibration(PROBE_A)) {
+        content &= ~(MEAS_EC_A | MEAS_TEMP_A);
+    }
+    if (!config_has_calibration(PROBE_B)) {
+        content &= ~(MEAS_EC_B | MEAS_TEMP_B);
+    }
+    return content;
+}
+
+// What the EZO worker needs for an EC read, set before the read is queued so
+// the worker does not look at the cycle state
+typedef struct {
+    probe_t probe;
+    uint8_t samples;
+    uint8_t compensate; // centi_C is valid
+    int16_t centi_C;
+} meas_ec_read_t;
+
+typedef enum {
+    MEAS_IDLE,
+    MEAS_WARMUP,
+    MEAS_TEMPERATURE,
+    MEAS_CONDUCTIVITY_A,
+    MEAS_CONDUCTIVITY_B,
+} meas_state_t;
+
+static struct {
+    meas_state_t state;
+    uint8_t publish; // Report the result to the MFM when done
+    uint8_t samples; // Readings per probe, from REG_MEAS_SAMPLES
+    uint8_t content; // MEAS_EC_A, ... from REG_MEAS_TYPE
+    uint8_t ezo;     // Conductivities are read from the EZO this cycle
+    uint8_t error_flags;
+    int result;
+    measurement_t measurement;
+    uint32_t cycle_start;
+    uint32_t mark;
+    uint32_t temp_ready; // When the DS18 conversions are done
+    ztimer_t timer;
+    msg_t step_msg;
+    ezoec_req_t ec_req; // EC read of the current probe on the EZO worker
+    meas_ec_read_t ec_read;
+    uint8_t ec_submitted;
+} meas = {
+    .state    = MEAS_IDLE,
+    .step_msg = {.type = MSG_MEAS_STEP},
+};
+
+static void meas_schedule(meas_state_t next, uint32_t delay) {
+    meas.state = next;
+    if (delay == 0) {
+        msg_t msg = {.type = MSG_MEAS_STEP};
+        if (msg_send_to_self(&msg) == 1) {
+            return;
         }
+        // Queue full, retry on the next tick
+        delay = 1;
+    }
+    ztimer_set_msg(ZTIMER_MSEC, &meas.timer, delay, &meas.step_msg, main_thread_pid);
+}
+
+static void meas_publish(void) {
+    if (meas.error_flags & ERR_SENSOR_INIT) {
+        mfm_comm_measurement_error(&mfm_comm, ERR_SENSOR_INIT);
+        return;
+    }
+    if (meas.error_flags != ERR_NONE) {
+        printf("ERR: %02X\n", meas.error_flags);
+        mfm_comm_measurement_error(&mfm_comm, meas.error_flags);
     }
 
-    if (config_has_calibration(PROBE_A)) {
-        result = sensors_get_conductivity(PROBE_A, &m->conductivity_a);
+    wire_measurement.conductivity_a = meas.measurement.conductivity_a;
+    wire_measurement.conductivity_b = meas.measurement.conductivity_b;
+    wire_measurement.temperature_a  = meas.measurement.temperature_a;
+    wire_measurement.temperature_b  = meas.measurement.temperature_b;
+
+    mfm_comm_measurement_finish(&mfm_comm, (void *)&wire_measurement, sizeof(wire_measurement));
+}
+
+static void meas_finish(void) {
+    if (!stream.active) {
+        sensors_disable();
+    }
+    phase_mark(PHASE_TOTAL, meas.cycle_start);
+    meas.state = MEAS_IDLE;
+    if (meas.publish) {
+        meas_publish();
+    }
+}
+
+// The probes whose temperature the cycle wants, as a PROBE_BIT() mask
+static uint8_t meas_temperature_probes(void) {
+    return ((meas.content & MEAS_TEMP_A) ? PROBE_BIT(PROBE_A) : 0) |
+           ((meas.content & MEAS_TEMP_B) ? PROBE_BIT(PROBE_B) : 0);
+}
+
+static void meas_trigger_temperatures(void) {
+    int failed = sensors_trigger_temperatures(meas_temperature_probes());
+    if (failed & PROBE_BIT(PROBE_A)) {
+        DEBUG("ERR trigger temp A\n");
+        meas.error_flags |= ERR_TEMP_A_TRIGGER;
+    }
+    if (failed & PROBE_BIT(PROBE_B)) {
+        DEBUG("ERR trigger temp B\n");
+        meas.error_flags |= ERR_TEMP_B_TRIGGER;
+    }
+    sensors_temperature_lost(failed);
+    meas.mark       = phase_mark(PHASE_TRIGGER, meas.mark);
+    // The DS18s are polled for completion, this is the worst case
+    meas.temp_ready = meas.mark + sensors_temperature_convert_ms(meas_temperature_probes());
+}
+
+static int meas_temperatures_converting(void) {
+    uint8_t probes = meas_temperature_probes();
+    if (meas.error_flags & ERR_TEMP_A_TRIGGER) {
+        probes &= ~PROBE_BIT(PROBE_A);
+    }
+    if (meas.error_flags & ERR_TEMP_B_TRIGGER) {
+        probes &= ~PROBE_BIT(PROBE_B);
+    }
+    return probes && (sensors_temperatures_converting(probes) & probes);
+}
+
+// Sets the DS18s' resolution, searching their ROMs if due, and starts their
+// conversions, if the cycle wants them.
+static int meas_start_temperatures(void) {
+    if (meas.content & MEAS_TEMP) {
+        int result = sensors_init_temperature();
         if (result < 0) {
-            DEBUG("ERR(%d) conduc A\n", result);
-            m->conductivity_a = 0;
-            *error_flags |= ERR_CONDUCTIVITY_A;
+            meas.result = result;
+            meas.error_flags |= ERR_SENSOR_INIT;
+            return result;
         }
     }
-    if (config_has_calibration(PROBE_B)) {
-        result = sensors_get_conductivity(PROBE_B, &m->conductivity_b);
+    meas_trigger_temperatures();
+    return 0;
+}
+
+// Cycles without EZO reads: temperatures only, or conductivities taken from
+// the stream. The boost is left as it is.
+static void meas_start_without_ezo(void) {
+    measurement_t *m = &meas.measurement;
+    if ((meas.content & MEAS_EC_A) && stream_value(PROBE_A, &m->conductivity_a) < 0) {
+        meas.error_flags |= ERR_CONDUCTIVITY_A;
+    }
+    if ((meas.content & MEAS_EC_B) && stream_value(PROBE_B, &m->conductivity_b) < 0) {
+        meas.error_flags |= ERR_CONDUCTIVITY_B;
+    }
+
+    if (meas_start_temperatures() < 0) {
+        meas_finish();
+        return;
+    }
+    meas_schedule(MEAS_TEMPERATURE, 0);
+}
+
+/**
+ * @brief Starts a measurement cycle, or merges into the one in flight.
+ *
+ * @param publish Report the result to the MFM when the cycle is done.
+ */
+static void meas_start(uint8_t publish) {
+    if (meas.state != MEAS_IDLE) {
+        DEBUG("Measurement in flight, merged\n");
+        meas.publish |= publish;
+        return;
+    }
+
+    meas.publish     = publish;
+    meas.error_flags = ERR_NONE;
+    meas.result      = 0;
+    memset(&meas.measurement, 0, sizeof(meas.measurement));
+    memset(phase_ms, 0, sizeof(phase_ms));
+
+    meas.cycle_start = ztimer_now(ZTIMER_MSEC);
+    meas.mark        = meas.cycle_start;
+    meas.samples     = mfm_comm.sample_count;
+    meas.content     = meas_content(mfm_comm.measurement_type);
+    meas.ezo         = (meas.content & MEAS_EC) && !stream.active;
+
+    // The rolling stream values are already filtered, samples do not apply
+    if (!meas.ezo) {
+        meas_start_without_ezo();
+        return;
+    }
+
+    // Listen before powering up so the *RE banner is not missed
+    int result = ezoec_open(&ec, &ec_params);
+    if (result < 0) {
+        DEBUG("ERR(%d) ezoec open\n", result);
+        meas.result = result;
+        meas.error_flags |= ERR_SENSOR_INIT;
+        meas_finish();
+        return;
+    }
+    sensors_enable();
+
+    // Convert during the warm-up, the EC reads compensate for the result
+    if (meas_start_temperatures() < 0) {
+        meas_finish();
+        return;
+    }
+    meas_schedule(MEAS_WARMUP, 0);
+}
+
+// Temperature of a probe read this cycle, NULL if there is none.
+static const int16_t *meas_temperature(probe_t probe) {
+    if (probe == PROBE_A) {
+        int ok = (meas.content & MEAS_TEMP_A) && !(meas.error_flags & (ERR_TEMP_A_TRIGGER | ERR_TEMP_A_READ));
+        return ok ? &meas.measurement.temperature_a : NULL;
+    }
+    int ok = (meas.content & MEAS_TEMP_B) && !(meas.error_flags & (ERR_TEMP_B_TRIGGER | ERR_TEMP_B_READ));
+    return ok ? &meas.measurement.temperature_b : NULL;
+}
+
+// The EZO streams at its 25 C reference, with tcomp fw the rolling values are
+// normalised once the cycle has the probe temperatures.
+static void meas_normalise_stream(void) {
+    if (!config_compensates_in_fw()) {
+        return;
+    }
+    measurement_t *m   = &meas.measurement;
+    const int16_t *t_a = meas_temperature(PROBE_A);
+    const int16_t *t_b = meas_temperature(PROBE_B);
+    if ((meas.content & MEAS_EC_A) && !(meas.error_flags & ERR_CONDUCTIVITY_A) && t_a != NULL) {
+        m->conductivity_a = ezoec_tc_normalise(m->conductivity_a, *t_a);
+    }
+    if ((meas.content & MEAS_EC_B) && !(meas.error_flags & ERR_CONDUCTIVITY_B) && t_b != NULL) {
+        m->conductivity_b = ezoec_tc_normalise(m->conductivity_b, *t_b);
+    }
+}
+
+static int meas_ec_op(ezoec_t *dev, ezoec_req_t *req) {
+    (void)dev;
+    const meas_ec_read_t *read = req->arg;
+    return sensors_sample_conductivity(read->probe, read->samples, read->compensate ? &read->centi_C : NULL,
+                                       &req->value);
+}
+
+/**
+ * @brief Reads the conductivity of a probe on the EZO worker.
+ *
+ * The first call queues the read and returns -EINPROGRESS, the step is run
+ * again on completion and then gets the result.
+ */
+static int meas_conductivity(probe_t probe, uint32_t *out) {
+    ezoec_req_t *req = &meas.ec_req;
+    if (req->result == -EINPROGRESS) {
+        return -EINPROGRESS;
+    }
+    if (!meas.ec_submitted) {
+        const int16_t *centi_C = meas_temperature(probe);
+
+        meas.ec_read.probe      = probe;
+        meas.ec_read.samples    = meas.samples;
+        meas.ec_read.compensate = (centi_C != NULL);
+        meas.ec_read.centi_C    = centi_C ? *centi_C : 0;
+        sensors_warn_probe(probe);
+
+        req->op       = meas_ec_op;
+        req->arg      = &meas.ec_read;
+        req->target   = main_thread_pid;
+        req->msg_type = MSG_MEAS_STEP;
+        int result    = ezoec_async_submit(&ec, req);
         if (result < 0) {
-            DEBUG("ERR(%d) conduc B\n", result);
-            m->conductivity_b = 0;
-            *error_flags |= ERR_CONDUCTIVITY_B;
+            return result;
         }
+        meas.ec_submitted = 1;
+        return -EINPROGRESS;
     }
 
-    if (config_has_calibration(PROBE_A)) {
-        result = sensors_get_temperature(PROBE_A, &m->temperature_a);
+    meas.ec_submitted = 0;
+    *out              = req->value;
+    return req->result;
+}
+
+static void meas_step(void) {
+    measurement_t *m = &meas.measurement;
+    int result;
+
+    switch (meas.state) {
+    case MEAS_IDLE:
+        break;
+    case MEAS_WARMUP: {
+        // Poll for the banner in slices so msgs are serviced while waiting
+        result           = ezoec_wait_ready(&ec, MEAS_WARMUP_POLL_MS);
+        uint32_t elapsed = ztimer_now(ZTIMER_MSEC) - meas.cycle_start;
+        if (result < 0 && elapsed < CONFIG_MEAS_WARMUP_MAX_MS) {
+            meas_schedule(MEAS_WARMUP, 0);
+            break;
+        }
+        // On timeout carry on, a full init handshake decides whether the EZO
+        // is there. Otherwise the banner proves the session is still good.
         if (result < 0) {
-            DEBUG("ERR(%d) get temp A\n", result);
-            m->temperature_a = 0;
-            *error_flags |= ERR_TEMP_A_READ;
+            ezoec_session_lost(&ec);
         }
-    }
-    if (config_has_calibration(PROBE_B)) {
-        result = sensors_get_temperature(PROBE_B, &m->temperature_b);
+        meas.mark = phase_mark(PHASE_WARMUP, meas.mark);
+        warmup_record(phase_ms[PHASE_WARMUP], result < 0);
+
+        result    = sensors_init_conductivity();
+        meas.mark = phase_mark(PHASE_INIT, meas.mark);
         if (result < 0) {
-            DEBUG("ERR(%d) get temp B\n", result);
-            m->temperature_b = 0;
-            *error_flags |= ERR_TEMP_B_READ;
+            DEBUG("ERR(%d) sensors init\n", result);
+            meas.result = result;
+            meas.error_flags |= ERR_SENSOR_INIT;
+            meas_finish();
+            break;
         }
+
+        // The conversions ran during the warm-up, likely they are done already
+        meas_schedule(MEAS_TEMPERATURE, 0);
+    } break;
+    case MEAS_TEMPERATURE: {
+        // Read as soon as every triggered bus finished, or once the worst
+        // case conversion time passed.
+        int32_t remaining = (int32_t)(meas.temp_ready - ztimer_now(ZTIMER_MSEC));
+        if (remaining > 0 && meas_temperatures_converting()) {
+            meas_schedule(MEAS_TEMPERATURE, remaining < MEAS_TEMP_POLL_MS ? (uint32_t)remaining : MEAS_TEMP_POLL_MS);
+            break;
+        }
+        int16_t temperatures[2];
+        int failed       = sensors_get_temperatures(meas_temperature_probes(), temperatures);
+        m->temperature_a = temperatures[PROBE_A];
+        m->temperature_b = temperatures[PROBE_B];
+        if (failed & PROBE_BIT(PROBE_A)) {
+            DEBUG("ERR get temp A\n");
+            meas.error_flags |= ERR_TEMP_A_READ;
+        }
+        if (failed & PROBE_BIT(PROBE_B)) {
+            DEBUG("ERR get temp B\n");
+            meas.error_flags |= ERR_TEMP_B_READ;
+        }
+        sensors_temperature_lost(failed);
+        meas.mark = phase_mark(PHASE_TEMPERATURE, meas.mark);
+        if (meas.ezo) {
+            meas_schedule(MEAS_CONDUCTIVITY_A, 0);
+        } else {
+            meas_normalise_stream();
+            meas_finish();
+        }
+    } break;
+    case MEAS_CONDUCTIVITY_A:
+        if (meas.content & MEAS_EC_A) {
+            result = meas_conductivity(PROBE_A, &m->conductivity_a);
+            if (result == -EINPROGRESS) {
+                break;
+            }
+            if (result < 0) {
+                DEBUG("ERR(%d) conduc A\n", result);
+                m->conductivity_a = 0;
+                meas.error_flags |= ERR_CONDUCTIVITY_A;
+            }
+        }
+        meas.mark = phase_mark(PHASE_CONDUCTIVITY_A, meas.mark);
+        meas_schedule(MEAS_CONDUCTIVITY_B, 0);
+        break;
+    case MEAS_CONDUCTIVITY_B:
+        if (meas.content & MEAS_EC_B) {
+            result = meas_conductivity(PROBE_B, &m->conductivity_b);
+            if (result == -EINPROGRESS) {
+                break;
+            }
+            if (result < 0) {
+                DEBUG("ERR(%d) conduc B\n", result);
+                m->conductivity_b = 0;
+                meas.error_flags |= ERR_CONDUCTIVITY_B;
+            }
+        }
+        meas.mark = phase_mark(PHASE_CONDUCTIVITY_B, meas.mark);
+        meas_finish();
+        break;
     }
+}
 
-    sensors_disable();
-    return 0;
+/**
+ * @brief Runs a full measurement cycle to completion, servicing other msgs
+ * while it waits. Used by the shell.
+ */
+static int perform_measurement(measurement_t *m, uint8_t *error_flags) {
+    meas_start(0);
+
+    msg_t msg;
+    while (meas.state != MEAS_IDLE) {
+        msg_receive(&msg);
+        app_handle_msg(&msg);
+    }
+
+    *m           = meas.measurement;
+    *error_flags = meas.error_flags;
+    return meas.result;
+}
+
+#define MEAS_TIME_INIT_MS   500  // EZO handshake and DS18 init
+#define MEAS_TIME_SELECT_MS 3500 // K value and calibration import, EZO reset and settle included
+#define MEAS_TIME_READ_MS   700  // One R round trip
+#define MEAS_TIME_TEMP_MS   50   // Reading out both DS18 scratchpads
+
+/**
+ * @brief Expected duration of a cycle with the type and sample count the
+ * master has set, reported in REG_MEAS_TIME. Called from the I2C ISR.
+ */
+static uint16_t mfm_comm_measurement_time(void *arg) {
+    mfm_comm_t *comm = arg;
+    uint8_t content  = meas_content(comm->measurement_type);
+
+    // The conversions run during the warm-up, the EC reads follow the
+    // temperature reads
+    uint32_t ms      = 0;
+    uint8_t reads_ec = (content & MEAS_EC) && !stream.active;
+    if (reads_ec) {
+        ms = CONFIG_MEAS_WARMUP_MAX_MS + MEAS_TIME_INIT_MS;
+    }
+    if (content & MEAS_TEMP) {
+        uint32_t convert_ms = sensors_temperature_convert_ms(PROBES_ALL);
+        ms                  = ((ms > convert_ms) ? ms : convert_ms) + MEAS_TIME_TEMP_MS;
+    }
+    if (reads_ec) {
+        uint8_t samples = comm->sample_count;
+        if (samples == 0) {
+            samples = 1;
+        } else if (samples > MEAS_MAX_SAMPLES) {
+            samples = MEAS_MAX_SAMPLES;
+        }
+        uint32_t probe_ms = (config_uses_correction() ? 0 : MEAS_TIME_SELECT_MS) + samples * MEAS_TIME_READ_MS;
+        if (content & MEAS_EC_A) {
+            ms += probe_ms;
+        }
+        if (content & MEAS_EC_B) {
+            ms += probe_ms;
+        }
+    }
+    return (ms > UINT16_MAX) ? UINT16_MAX : ms;
 }
 
 // ==================================
@@ -394,7 +1293,9 @@ static char *_int_to_string(uint32_t k, uint8_t precision, char *buf) {
 }
 
 #define STABLE_READING_SAMPLES 12
-static int wait_for_stable_readings(uint32_t timeout, uint32_t tolerance_uS) {
+// Waits until the last STABLE_READING_SAMPLES readings are within tolerance_uS
+// of each other. Their mean goes to out_nS at the full nS resolution.
+static int wait_for_stable_readings(uint32_t timeout, uint32_t tolerance_uS, uint32_t *out_nS) {
     uint32_t readings[STABLE_READING_SAMPLES] = {0};
     uint8_t total_readings                    = 0;
 
@@ -413,13 +1314,11 @@ static int wait_for_stable_readings(uint32_t timeout, uint32_t tolerance_uS) {
         if (result < 0) {
             return result; // Return the error code
         }
-        // Convert nS to uS
-        readings[total_readings % STABLE_READING_SAMPLES] /= 1000;
         total_readings++;
 
         // Only check std with X samples
-        printf("Collecting samples: %2d \t-->\t%ld uS\n", total_readings,
-               readings[(total_readings - 1) % STABLE_READING_SAMPLES]);
+        printf("Collecting samples: %2d \t-->\t%" PRIu32 " uS\n", total_readings,
+               readings[(total_readings - 1) % STABLE_READING_SAMPLES] / 1000);
         if (total_readings < STABLE_READING_SAMPLES) {
             continue;
         }
@@ -436,10 +1335,17 @@ static int wait_for_stable_readings(uint32_t timeout, uint32_t tolerance_uS) {
         }
         uint32_t spread = max - min;
 
-        printf("Min: %" PRIu32 "\tMax: %" PRIu32 "\tSpread: %" PRIu32 " uS\tTolerance: %" PRIu32 " uS\n", min, max,
-               spread, tolerance_uS);
+        printf("Min: %" PRIu32 "\tMax: %" PRIu32 "\tSpread: %" PRIu32 " uS\tTolerance: %" PRIu32 " uS\n", min / 1000,
+               max / 1000, spread / 1000, tolerance_uS);
 
-        if (spread <= tolerance_uS) {
+        if (spread <= (uint64_t)tolerance_uS * 1000) {
+            if (out_nS != NULL) {
+                uint64_t sum = 0;
+                for (int i = 0; i < STABLE_READING_SAMPLES; i++) {
+                    sum += readings[i];
+                }
+                *out_nS = sum / STABLE_READING_SAMPLES;
+            }
             return 0; // Stable
         }
     }
@@ -503,21 +1409,41 @@ static int32_t _read_kvalue(void) { return _read_int(1); }
 #define CAL_TOLERANCE_DRY_uS  1000
 #define CAL_TOLERANCE_LOW_uS  1000
 #define CAL_TOLERANCE_HIGH_uS 1000
+// K the EZO is left at in firmware correction mode, the probe's cell constant
+// ends up in its correction.
+#define CAL_REFERENCE_K       10
 int cmd_provision(int argc, char **argv) {
     int calibrate_a = 1;
     int calibrate_b = 1;
+    int correction  = 0;
 
-    if (argc >= 2) {
-        if (argv[1][0] == 'A' || argv[1][0] == 'a') {
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "fw") == 0) {
+            correction = 1;
+        } else if (argv[arg][0] == 'A' || argv[arg][0] == 'a') {
             calibrate_b = 0;
-        } else if (argv[1][0] == 'B' || argv[1][0] == 'b') {
+        } else if (argv[arg][0] == 'B' || argv[arg][0] == 'b') {
             calibrate_a = 0;
         } else {
-            printf("Usage: %s [A|B]\n", argv[0]);
+            printf("Usage: %s [A|B] [fw]\n", argv[0]);
             return -1;
         }
     }
 
+    // Calibrations of the other mode are useless after this, the factory
+    // reset below wipes what the EZO holds.
+    if (correction != config_uses_correction()) {
+        eeprom_config.flags &= ~(CFG_FLAG_A_CALIBRATED | CFG_FLAG_B_CALIBRATED);
+        if (!calibrate_a || !calibrate_b) {
+            puts("!!! NOTICE: calibration mode changed, the other probe must be provisioned again");
+        }
+    }
+    if (correction) {
+        eeprom_config.flags |= CFG_FLAG_FW_CORRECTION;
+    } else {
+        eeprom_config.flags &= ~CFG_FLAG_FW_CORRECTION;
+    }
+
     puts("1. Fixing EZOEC configuration");
     ezoec_params_t params = {
         .baud_rate = 9600,
@@ -560,7 +1486,20 @@ int cmd_provision(int argc, char **argv) {
     puts("Disabled EZOEC LED");
 
     int k_value;
-    if (calibrate_a) {
+    if (correction) {
+        // The EZO stays uncalibrated at a fixed K, probes differ only in their
+        // firmware correction.
+        result = ezoec_set_k(&ec, CAL_REFERENCE_K);
+        if (result < 0) {
+            printf("There are issues setting the K value (error %d).\n", result);
+            return result;
+        }
+        if (calibrate_a)
+            eeprom_config.k_values[0] = CAL_REFERENCE_K;
+        if (calibrate_b)
+            eeprom_config.k_values[1] = CAL_REFERENCE_K;
+    }
+    if (calibrate_a && !correction) {
     retry_ka:
         puts("2. K-Value of probe A: ");
         k_value = _read_kvalue();
@@ -572,7 +1511,7 @@ int cmd_provision(int argc, char **argv) {
         printf("Got %s\n", _int_to_string(k_value, 1, NULL));
     }
 
-    if (calibrate_b) {
+    if (calibrate_b && !correction) {
     retry_kb:
         puts("3. K-Value of probe B: ");
         k_value = _read_kvalue();
@@ -592,11 +1531,17 @@ int cmd_provision(int argc, char **argv) {
         printf("Switching to probe: %c (K: %s)\n", probe == 0 ? 'A' : 'B',
                _int_to_string(eeprom_config.k_values[probe], 1, NULL));
         switch_probe(probe);
-        result = ezoec_set_k(&ec, eeprom_config.k_values[probe]);
-        if (result < 0) {
-            printf("There are issues setting the K value (error %d).\n", result);
-            return result;
+        if (!correction) {
+            result = ezoec_set_k(&ec, eeprom_config.k_values[probe]);
+            if (result < 0) {
+                printf("There are issues setting the K value (error %d).\n", result);
+                return result;
+            }
         }
+        uint32_t raw_dry_nS  = 0;
+        uint32_t raw_low_nS  = 0;
+        uint32_t raw_high_nS = 0;
+        uint32_t ref_low_uS  = 0;
     retry_dry:
         printf("4%c.1: Dry calibration. Make sure the probe is dry and "
                "press "
@@ -604,14 +1549,14 @@ int cmd_provision(int argc, char **argv) {
                probe == 0 ? 'A' : 'B');
         _wait_for_enter();
         puts("Waiting for readings to stabalize...");
-        result = wait_for_stable_readings(10000, CAL_TOLERANCE_DRY_uS);
+        result = wait_for_stable_readings(10000, CAL_TOLERANCE_DRY_uS, &raw_dry_nS);
         if (result < 0) {
             printf("There are issues getting a stable reading (error %d). "
                    "Check connections and dryness.\n",
                    result);
             goto retry_dry;
         }
-        result = ezoec_cal_dry(&ec);
+        result = correction ? 0 : ezoec_cal_dry(&ec);
         if (result < 0) {
             printf("Could not perform calibration: %d\n", result);
             return result;
@@ -624,14 +1569,15 @@ int cmd_provision(int argc, char **argv) {
         uint32_t uS = _read_mS();
         printf("Calibrating for: %s mS\n", _int_to_string(uS, 3, NULL));
         puts("Waiting for readings to stabalize...");
-        result = wait_for_stable_readings(10000, CAL_TOLERANCE_LOW_uS);
+        result = wait_for_stable_readings(10000, CAL_TOLERANCE_LOW_uS, &raw_low_nS);
         if (result < 0) {
             printf("There are issues getting a stable reading (error %d). "
                    "Check for trapped air.\n",
                    result);
             goto retry_low;
         }
-        result = ezoec_cal_low(&ec, uS);
+        ref_low_uS = uS;
+        result     = correction ? 0 : ezoec_cal_low(&ec, uS);
         if (result < 0) {
             printf("Could not perform calibration: %d\n", result);
             return result;
@@ -643,19 +1589,31 @@ int cmd_provision(int argc, char **argv) {
         uS = _read_mS();
         printf("Calibrating for: %s mS\n", _int_to_string(uS, 3, NULL));
         puts("Waiting for readings to stabalize...");
-        result = wait_for_stable_readings(10000, CAL_TOLERANCE_HIGH_uS);
+        result = wait_for_stable_readings(10000, CAL_TOLERANCE_HIGH_uS, &raw_high_nS);
         if (result < 0) {
             printf("There are issues getting a stable reading (error %d). "
                    "Check for trapped air.\n",
                    result);
             goto retry_high;
         }
-        result = ezoec_cal_high(&ec, uS);
+        result = correction ? 0 : ezoec_cal_high(&ec, uS);
         if (result < 0) {
             printf("Could not perform calibration: %d\n", result);
             return result;
         }
 
+        if (correction) {
+            printf("7%c.1: Calibration done, computing correction...", probe == 0 ? 'A' : 'B');
+            result = ezoec_correction_fit(&eeprom_config.correction[probe], raw_dry_nS, raw_low_nS,
+                                          ref_low_uS * 1000, raw_high_nS, uS * 1000);
+            if (result < 0) {
+                printf("Readings do not increase from dry to low to high: %d\n", result);
+                return result;
+            }
+            eeprom_config.flags |= CFG_FLAG_A_CALIBRATED << probe;
+            continue;
+        }
+
         printf("7%c.1: Calibration done, exporting calibration values...", probe == 0 ? 'A' : 'B');
         result = ezoec_cal_export(&ec, &eeprom_config.calibration[probe]);
         if (result < 0) {
@@ -683,6 +1641,9 @@ int cmd_ec_cmd(int argc, char **argv) {
         return -1;
     }
 
+    // A raw command may change the calibration behind our back.
+    ec.cal_fingerprint = 0;
+    ezoec_lock(&ec);
     ezoec_writeline(&ec, argv[1]);
     char buf[RX_MAX_LINE_LEN] = {0};
     int result                = 0;
@@ -693,13 +1654,20 @@ int cmd_ec_cmd(int argc, char **argv) {
         buf[result] = 0;
         printf("<<< %s\n", buf);
     }
+    ezoec_unlock(&ec);
 
     return 0;
 }
 
 int cmd_do_measurement(int argc, char **argv) {
-    (void)argc;
-    (void)argv;
+    // Same as the master writing REG_MEAS_SAMPLES and REG_MEAS_TYPE
+    if (argc >= 2) {
+        mfm_comm.sample_count = strtoul(argv[1], NULL, 0);
+    }
+    if (argc >= 3) {
+        mfm_comm.measurement_type = strtoul(argv[2], NULL, 0);
+    }
+    printf("Expected %u ms\n", mfm_comm_measurement_time(&mfm_comm));
 
     measurement_t measurement = {0};
     uint8_t error_flags       = ERR_NONE;
@@ -721,6 +1689,173 @@ int cmd_do_measurement(int argc, char **argv) {
     return 0;
 }
 
+int cmd_bench(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: %s <cycles>\n", argv[0]);
+        return -1;
+    }
+    uint32_t cycles = strtoul(argv[1], NULL, 0);
+
+    uint32_t min[PHASE_NUMOF];
+    uint32_t max[PHASE_NUMOF] = {0};
+    uint64_t sum[PHASE_NUMOF] = {0};
+    uint32_t failed           = 0;
+    memset(min, 0xFF, sizeof(min));
+
+    for (uint32_t cycle = 0; cycle < cycles; cycle++) {
+        measurement_t measurement = {0};
+        uint8_t error_flags       = ERR_NONE;
+
+        perform_measurement(&measurement, &error_flags);
+        if (error_flags != ERR_NONE) {
+            failed++;
+        }
+        for (int p = 0; p < PHASE_NUMOF; p++) {
+            if (phase_ms[p] < min[p])
+                min[p] = phase_ms[p];
+            if (phase_ms[p] > max[p])
+                max[p] = phase_ms[p];
+            sum[p] += phase_ms[p];
+        }
+    }
+    if (cycles == 0) {
+        return 0;
+    }
+
+    printf("%" PRIu32 " cycles, %" PRIu32 " with errors\n", cycles, failed);
+    printf("phase          min      avg      max  (ms)\n");
+    for (int p = 0; p < PHASE_NUMOF; p++) {
+        printf("%-8s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 "\n", phase_names[p], min[p], (uint32_t)(sum[p] / cycles),
+               max[p]);
+    }
+
+    return 0;
+}
+
+int cmd_warmup(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    unsigned total = 0;
+    for (unsigned bin = 0; bin < WARMUP_HIST_BINS; bin++) {
+        total += warmup_stats.bins[bin];
+    }
+    if (total == 0) {
+        puts("No warm-ups recorded");
+        return 0;
+    }
+
+    printf("%u warm-ups, min %" PRIu32 " ms, max %" PRIu32 " ms, %u timed out (cap %u ms)\n", total,
+           warmup_stats.min_ms, warmup_stats.max_ms, warmup_stats.timeouts, CONFIG_MEAS_WARMUP_MAX_MS);
+    for (unsigned bin = 0; bin < WARMUP_HIST_BINS; bin++) {
+        if (warmup_stats.bins[bin] == 0) {
+            continue;
+        }
+        printf("%5u - %5u ms: %u\n", bin * WARMUP_HIST_BIN_MS, (bin + 1) * WARMUP_HIST_BIN_MS - 1,
+               warmup_stats.bins[bin]);
+    }
+    return 0;
+}
+
+#if IS_USED(MODULE_MFM_COMM_STATS)
+static void print_isr_stat(const char *name, const mfm_comm_isr_stat_t *stat) {
+    uint32_t mean = stat->count ? stat->total_us / stat->count : 0;
+    printf("%-8s %8" PRIu32 " calls, mean %4" PRIu32 " us, max %5u us\n", name, stat->count, mean, stat->max_us);
+}
+
+int cmd_comm(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+        unsigned state = irq_disable();
+        memset(&mfm_comm.isr_prepare, 0, sizeof(mfm_comm.isr_prepare));
+        memset(&mfm_comm.isr_finish, 0, sizeof(mfm_comm.isr_finish));
+        irq_restore(state);
+        return 0;
+    }
+
+    // Copy out of the ISR's way so each line is consistent
+    unsigned state              = irq_disable();
+    mfm_comm_isr_stat_t prepare = mfm_comm.isr_prepare;
+    mfm_comm_isr_stat_t finish  = mfm_comm.isr_finish;
+    irq_restore(state);
+
+    print_isr_stat("prepare", &prepare);
+    print_isr_stat("finish", &finish);
+    return 0;
+}
+#endif
+
+int cmd_stream(int argc, char **argv) {
+    if (argc >= 2) {
+        int on = strcmp(argv[1], "on") == 0;
+        if (!on && strcmp(argv[1], "off") != 0) {
+            printf("Usage: %s [on|off]\n", argv[0]);
+            return 1;
+        }
+        if (on) {
+            eeprom_config.flags |= CFG_FLAG_STREAMING;
+        } else {
+            eeprom_config.flags &= ~CFG_FLAG_STREAMING;
+        }
+        config_persist();
+
+        int result = on ? stream_start() : stream_stop();
+        if (result < 0) {
+            printf("ERR: %d\n", result);
+            return 1;
+        }
+    }
+
+    // The shell has no msg loop, take in what the worker forwarded so far
+    msg_t msg;
+    while (msg_try_receive(&msg) == 1) {
+        app_handle_msg(&msg);
+    }
+
+    printf("Streaming: %s (%s)\n", stream.active ? "on" : "off", config_streams() ? "enabled" : "disabled");
+    uint32_t now = ztimer_now(ZTIMER_MSEC);
+    for (int probe = 0; probe < 2; probe++) {
+        stream_filter_t *f = &stream.filter[probe];
+        if (f->samples == 0) {
+            printf("Probe %c: no readings\n", 'A' + probe);
+            continue;
+        }
+        printf("Probe %c: %s uS, %u readings, %" PRIu32 " ms ago%s\n", 'A' + probe,
+               _int_to_string(f->value_nS, 3, NULL), f->samples, now - f->updated,
+               (stream.active && (int)stream.probe == probe) ? " (streaming)" : "");
+    }
+    return 0;
+}
+
+int cmd_tcomp(int argc, char **argv) {
+    if (argc == 2) {
+        int fw = strcmp(argv[1], "fw") == 0;
+        if (!fw && strcmp(argv[1], "ezo") != 0) {
+            printf("Usage: %s [ezo|fw] | %s <uS> <centi C>\n", argv[0], argv[0]);
+            return 1;
+        }
+        if (fw) {
+            eeprom_config.flags |= CFG_FLAG_FW_TEMP_COMP;
+        } else {
+            eeprom_config.flags &= ~CFG_FLAG_FW_TEMP_COMP;
+        }
+        config_persist();
+    } else if (argc == 3) {
+        // Evaluates the table for a reading, e.g. "tcomp 16880 4000"
+        uint32_t nS     = strtoul(argv[1], NULL, 10) * 1000;
+        int16_t centi_C = atoi(argv[2]);
+        printf("%" PRIu32 " uS at %d cC -> %" PRIu32 " uS at 25 C\n", nS / 1000, centi_C,
+               ezoec_tc_normalise(nS, centi_C) / 1000);
+        return 0;
+    }
+
+    printf("Temperature compensation: %s\n", config_compensates_in_fw() ? "firmware" : "EZO");
+    // The EZO streams without RT, only the firmware can compensate those
+    if (config_streams() && !config_compensates_in_fw()) {
+        puts("Streamed conductivities are not compensated, use fw");
+    }
+    return 0;
+}
+
 void _print_ezoec_calibration(ezoec_calibration_t *cal) {
     for (int ix = 0; ix < EZOEC_CALIBRATION_MAX_LINES; ix++) {
         printf("%.*s", EZOEC_CALIBRATION_LINE_LENGTH, cal->line[ix]);
@@ -731,6 +1866,16 @@ int cmd_config_export(int argc, char **argv) {
     (void)argc;
     (void)argv;
 
+    if (config_uses_correction()) {
+        for (int probe = 0; probe < 2; probe++) {
+            ezoec_correction_t *corr = &eeprom_config.correction[probe];
+            printf("Probe %c correction: dry %" PRIu32 " nS, knee %" PRIu32 " nS, gain %" PRIu32 "/%" PRIu32
+                   " (Q16)\n",
+                   'A' + probe, corr->dry_nS, corr->knee_nS, corr->gain_low_q16, corr->gain_high_q16);
+        }
+        return 0;
+    }
+
     puts("=============== PROBE A ===================");
     printf("K-Value: %s\nCalibration: ", _int_to_string(eeprom_config.k_values[PROBE_A], 1, NULL));
     _print_ezoec_calibration(&eeprom_config.calibration[PROBE_A]);
@@ -838,8 +1983,12 @@ int cmd_boost(int argc, char **argv) {
 }
 
 int cmd_temp(int argc, char **argv) {
-    (void)argc;
-    (void)argv;
+    uint8_t bits = (argc >= 2) ? atoi(argv[1]) : CONFIG_TEMP_RESOLUTION;
+    int persist  = (argc >= 3) && strcmp(argv[2], "save") == 0;
+    if (bits < DS18_RESOLUTION_MIN || bits > DS18_RESOLUTION_MAX) {
+        printf("Usage: %s [9-12 bit] [save]\n", argv[0]);
+        return 1;
+    }
 
     int status = ds18_init(&t1, &t1_params);
     if (status < 0) {
@@ -850,37 +1999,63 @@ int cmd_temp(int argc, char **argv) {
         printf("Error init B: %d\n", status);
     }
 
-    int16_t out_a = 0;
-    int16_t out_b = 0;
-
-    status = ds18_trigger(&t1);
-    if (status < 0) {
-        printf("Error trig A: %d\n", status);
+    ds18_t *buses[] = {&t1, &t2};
+    for (int probe = 0; probe < 2; probe++) {
+        status = ds18_search(buses[probe]);
+        if (status < 0) {
+            printf("Error search %c: %d\n", 'A' + probe, status);
+        }
+        for (uint8_t i = 0; i < buses[probe]->count; i++) {
+            const uint8_t *id = buses[probe]->rom[i].id;
+            printf("%c[%u]: %02x%02x%02x%02x%02x%02x%02x%02x\n", 'A' + probe, i, id[0], id[1], id[2], id[3], id[4],
+                   id[5], id[6], id[7]);
+        }
+        status = ds18_set_resolution(buses[probe], bits, persist);
+        if (status < 0) {
+            printf("Error resolution %c: %d\n", 'A' + probe, status);
+        }
     }
-    status = ds18_trigger(&t2);
-    if (status < 0) {
-        printf("Error trig B: %d\n", status);
+
+    status = sensors_trigger_temperatures(PROBES_ALL);
+    for (int probe = 0; probe < 2; probe++) {
+        if (status & PROBE_BIT(probe)) {
+            printf("Error trig %c\n", 'A' + probe);
+        }
     }
 
-    ztimer_sleep(ZTIMER_MSEC, 1000);
+    for (int probe = 0; probe < 2; probe++) {
+        int16_t out[CONFIG_DS18_MAX_DEVICES] = {0};
 
-    status = ds18_read(&t1, &out_a);
-    if (status < 0) {
-        printf("Error read A: %d\n", status);
-    }
-    status = ds18_read(&t2, &out_b);
-    if (status < 0) {
-        printf("Error read B: %d\n", status);
+        uint32_t start = ztimer_now(ZTIMER_MSEC);
+        status         = ds18_wait_conversion(buses[probe], ds18_conversion_ms(buses[probe]));
+        if (status < 0) {
+            printf("Error convert %c: %d\n", 'A' + probe, status);
+        } else {
+            printf("Conversion %c: done after %" PRIu32 " ms\n", 'A' + probe, ztimer_now(ZTIMER_MSEC) - start);
+        }
+
+        status = ds18_read_all(buses[probe], out);
+        if (status < 0) {
+            printf("Error read %c: %d\n", 'A' + probe, status);
+            continue;
+        }
+        for (int i = 0; i < status; i++) {
+            printf("Temperature %c[%d]: %d\n", 'A' + probe, i, out[i]);
+        }
     }
 
-    printf("Temperature A: %d\n", out_a);
-    printf("Temperature B: %d\n", out_b);
+    for (int probe = 0; probe < 2; probe++) {
+        const ds18_stats_t *stats = &buses[probe]->stats;
+        printf("Bus %c: %" PRIu32 " reads, %" PRIu32 " retries, %" PRIu32 " failed\n", 'A' + probe, stats->reads,
+               stats->retries, stats->failures);
+    }
 
     return 0;
 }
 
-/* test 1 — raw cycle-burn calibration: toggle DQ_B_PIN with <loops>
- * iterations of the asm loop between each edge. */
+#if !IS_USED(MODULE_MFM_SIM)
+/* test 1 — burn loop calibration on DQ_B, through the driver's open drain
+ * BSRR edges. Needs the bus pull-up for the rising edges. */
 static int test_cycle_burn(int argc, char **argv) {
     if (argc < 1) {
         printf("Usage: test 1 <loops> [edges]\n");
@@ -892,71 +2067,54 @@ static int test_cycle_burn(int argc, char **argv) {
     uint32_t loops = (uint32_t)atoi(argv[0]);
     uint32_t edges = (argc >= 2) ? (uint32_t)atoi(argv[1]) : 2000;
 
-    gpio_init(DQ_B_PIN, GPIO_OUT);
-    gpio_clear(DQ_B_PIN);
-
-    unsigned irq = irq_disable();
-    if (loops == 0) {
-        for (uint32_t i = 0; i < edges; i++) {
-            gpio_set(DQ_B_PIN);
-            gpio_clear(DQ_B_PIN);
-        }
-    } else {
-        for (uint32_t i = 0; i < edges; i += 2) {
-            gpio_set(DQ_B_PIN);
-            ds18_burn_loops(loops);
-            gpio_clear(DQ_B_PIN);
-            ds18_burn_loops(loops);
-        }
+    // A scratch descriptor, t2 keeps the ROMs of its bus
+    ds18_t bus;
+    if (ds18_init(&bus, &t2_params) != DS18_OK) {
+        puts("ERR: DQ_B init");
+        return 1;
     }
-    irq_restore(irq);
-
-    gpio_init(DQ_B_PIN, GPIO_IN);
-    printf("Done: %lu edges with %lu loops each\n",
-           (unsigned long)edges, (unsigned long)loops);
+    ds18_test_burn(&bus, loops, edges);
+    printf("Done: %lu edges with %lu loops each\n", (unsigned long)edges, (unsigned long)loops);
     return 0;
 }
 
-/* Single pulse: rising edge, DS18_DELAY_US(us) high, falling edge.
- * `us` must be a compile-time constant so the loop count folds. */
-#define VALIDATE_DELAY(us)                                                     \
-    do {                                                                       \
-        gpio_set(DQ_B_PIN);                                                    \
-        DS18_DELAY_US(us);                                                     \
-        gpio_clear(DQ_B_PIN);                                                  \
-    } while (0)
-
-/* test 2 — validate DS18_DELAY_US against the datasheet timings.
- * Emits one high pulse per delay value with a long low gap between them. */
+/* test 2 — the driver's slots on DQ_B, as the bus sees them. */
 static int test_delay_validate(int argc, char **argv) {
-    (void)argc; (void)argv;
-
-    printf("Validating DS18_DELAY_US on DQ_B_PIN.\n");
-    printf("One pulse each, high times: 1, 10, 60, 480 us.\n");
-    printf("Pulses separated by a ~5 ms low gap.\n");
-
-    gpio_init(DQ_B_PIN, GPIO_OUT);
-    gpio_clear(DQ_B_PIN);
-
-    unsigned irq = irq_disable();
-    VALIDATE_DELAY(5);
-    VALIDATE_DELAY(15);
-    VALIDATE_DELAY(50);
-    VALIDATE_DELAY(400);
-    irq_restore(irq);
+    (void)argc;
+    (void)argv;
 
-    ztimer_sleep(ZTIMER_MSEC, 1);
+    printf("Driver slots on DQ_B_PIN, low times:\n");
+    printf("  reset 480 us, presence sampled 60 us after release, 480 us tail\n");
+    printf("  write-0 60 us, write-1 1 us, read 1 us sampled 10 us after the fall\n");
 
-    gpio_init(DQ_B_PIN, GPIO_IN);
+    // A scratch descriptor, t2 keeps the ROMs of its bus
+    ds18_t bus;
+    if (ds18_init(&bus, &t2_params) != DS18_OK) {
+        puts("ERR: DQ_B init");
+        return 1;
+    }
+    ds18_test_slots(&bus);
     printf("Done.\n");
     return 0;
 }
+#else
+static int test_cycle_burn(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    puts("Not on the simulated bus");
+    return 1;
+}
+
+static int test_delay_validate(int argc, char **argv) {
+    return test_cycle_burn(argc, argv);
+}
+#endif
 
 int cmd_test(int argc, char **argv) {
     if (argc < 2) {
         printf("Usage: test <n> [args...]\n");
         printf("  1 <loops> [edges]   Cycle-burn calibration toggle on DQ_B_PIN.\n");
-        printf("  2                   Validate DS18_DELAY_US (1/10/60/480 us pulses).\n");
+        printf("  2                   Driver reset, write-0/1 and read slots on DQ_B_PIN.\n");
         return 1;
     }
     int n = atoi(argv[1]);
@@ -971,8 +2129,8 @@ int cmd_test(int argc, char **argv) {
 }
 
 static const shell_command_t shell_commands[] = {
-    {"provision", "Full provisioning sequence for EC Module board [A|B]", cmd_provision     },
-    {"measure",   "Performs a full measurement",                          cmd_do_measurement},
+    {"provision", "Full provisioning sequence [A|B] [fw]",                cmd_provision     },
+    {"measure",   "Performs a measurement [samples] [type]",              cmd_do_measurement},
     {"export",    "Exports the currently loaded configuration",           cmd_config_export },
     {"switch",    "Switches the current active probe",                    cmd_switch_probe  },
     {"set_k",     "Sets the K-Value for a probe",                         cmd_set_k         },
@@ -980,8 +2138,18 @@ static const shell_command_t shell_commands[] = {
     {"factory",   "Clears all configuration and calibrations",            cmd_factory_reset },
     {"ec_cmd",    "Debugging: send command to EZOEC module",              cmd_ec_cmd        },
     {"boost",     "Enable or disable the 5V booster",                     cmd_boost         },
-    {"temp",      "Get temperature",                                      cmd_temp          },
-    {"test",      "Run a test: test <n> (1=cycle burn, 2=delay validate)", cmd_test },
+    {"temp",      "Get temperature [bits] [save]",                        cmd_temp          },
+    {"test",      "Run a test: test <n> (1=cycle burn, 2=DS18 slots)",   cmd_test          },
+    {"bench",     "Runs N measurement cycles, prints phase timings",      cmd_bench         },
+    {"warmup",    "Shows the distribution of boost warm-up times",        cmd_warmup        },
+    {"stream",    "Continuous EZO readings [on|off], shows rolling values", cmd_stream        },
+    {"tcomp",     "Temperature compensation on the EZO or in firmware [ezo|fw]", cmd_tcomp   },
+#if IS_USED(MODULE_MFM_COMM_STATS)
+    {"comm",      "I2C callback timings in the ISR [reset]",              cmd_comm          },
+#endif
+#if IS_USED(MODULE_MFM_SIM)
+    {"sim",       "Drives the simulated EZO, DS18s and MFM master",       mfm_sim_cmd       },
+#endif
     {NULL,        NULL,                                                   NULL              },
 };
 
@@ -993,6 +2161,10 @@ int main_shell(void) {
 
 #define SHELL_MAGIC 0x24C0FFEE
 int should_boot_shell(void) {
+#ifdef CPU_NATIVE
+    // There is no backup domain on the host, always run the shell.
+    return 1;
+#else
     // If magic already set then we should boot to shell
     if (RTC->BKP0R == SHELL_MAGIC) {
         // clear magic to bkp0r
@@ -1011,12 +2183,46 @@ int should_boot_shell(void) {
     ztimer_set_msg(ZTIMER_MSEC, &clear_timer, 500, &clear_msg, main_thread_pid);
 
     return 0;
+#endif
 }
 
 // ==================================
 // Main routine
 // ==================================
 
+static void app_handle_msg(msg_t *msg) {
+    switch (msg->type) {
+    case MSG_MFR_INIT:
+        DEBUG("Sensor init\n");
+        mfm_comm_sensor_init_finish(&mfm_comm);
+        break;
+    case MSG_DO_MEASURE:
+        DEBUG("Sensor measure\n");
+        meas_start(1);
+        break;
+    case MSG_MEAS_STEP:
+        meas_step();
+        break;
+    case MSG_STREAM_READING:
+        stream_reading(msg->content.value);
+        break;
+    case MSG_STREAM_SWITCH:
+        if (stream.active) {
+            stream_switch(stream.probe);
+        }
+        break;
+    case MSG_STREAM_SWITCHED:
+        stream_switched();
+        break;
+    case MSG_CLEAR_BOOT_MAGIC:
+#ifndef CPU_NATIVE
+        PWR->CR |= PWR_CR_DBP;
+        RTC->BKP0R = 0;
+#endif
+        break;
+    }
+}
+
 #define PIN_TEST GPIO_PIN(PORT_A, 15)
 static msg_t _msg_queue[8] = {0};
 int main(void) {
@@ -1029,9 +2235,18 @@ int main(void) {
     main_thread_pid = thread_getpid();
     msg_init_queue(_msg_queue, 8);
 
+#if IS_USED(MODULE_MFM_SIM)
+    mfm_sim_init();
+#endif
+
     // Setup I2C with master.
     mfm_comm_init(&mfm_comm, mfm_comm_params);
 
+    // EZO commands of the measurement cycle run on their own thread
+    if (ezoec_async_init(&ec) < 0) {
+        puts("!!! NOTICE: could not start the EZO worker");
+    }
+
     config_init();
 
     printf("FWVER: %s\n", FW_VERSION);
@@ -1040,44 +2255,15 @@ int main(void) {
     if (should_boot_shell())
         return main_shell();
 
+    if (config_streams() && stream_start() < 0) {
+        puts("!!! NOTICE: could not start streaming");
+    }
+
     static msg_t msg = {0};
     for (;;) {
         DEBUG("Wait msg\n");
         msg_receive(&msg);
-        switch (msg.type) {
-        case MSG_MFR_INIT:
-            DEBUG("Sensor init\n");
-            mfm_comm_sensor_init_finish(&mfm_comm);
-            break;
-        case MSG_DO_MEASURE: {
-            DEBUG("Sensor measure\n");
-
-            measurement_t measurement = {0};
-            uint8_t error_flags       = ERR_NONE;
-
-            perform_measurement(&measurement, &error_flags);
-
-            if (error_flags & ERR_SENSOR_INIT) {
-                mfm_comm_measurement_error(&mfm_comm, ERR_SENSOR_INIT);
-                break;
-            }
-            if (error_flags != ERR_NONE) {
-                printf("ERR: %02X\n", error_flags);
-                mfm_comm_measurement_error(&mfm_comm, error_flags);
-            }
-
-            wire_measurement.conductivity_a = measurement.conductivity_a;
-            wire_measurement.conductivity_b = measurement.conductivity_b;
-            wire_measurement.temperature_a  = measurement.temperature_a;
-            wire_measurement.temperature_b  = measurement.temperature_b;
-
-            mfm_comm_measurement_finish(&mfm_comm, (void *)&wire_measurement, sizeof(wire_measurement));
-        } break;
-        case MSG_CLEAR_BOOT_MAGIC:
-            PWR->CR |= PWR_CR_DBP;
-            RTC->BKP0R = 0;
-            break;
-        }
+        app_handle_msg(&msg);
     }
     return 0;
 }
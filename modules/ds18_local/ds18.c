@@ -28,11 +28,17 @@
  * BNE-taken = 2 cycles), with ART prefetch hiding the 1 flash wait state.
  *
  * Loops are derived from CLOCK_CORECLOCK so the timings remain correct if
- * the clock config ever changes. The long convert delay (750 ms) stays on
- * ztimer so the CPU can sleep.
+ * the clock config ever changes. The wait for a conversion (up to 750 ms)
+ * polls the bus and sleeps on ztimer between polls so the CPU can sleep.
  *
  * IRQs are masked across the timing-critical section of each bit slot to
  * keep ISR jitter from pushing the sample point outside the 1-Wire window.
+ * Inside that window an edge is one BSRR write on a pin that stays open
+ * drain, so the only variable cost left is the burn loop itself. The 1 us
+ * low pulse that the gpio_init() overhead used to stretch is now explicit.
+ * The loop figures above were taken with gpio_set()/gpio_clear() edges;
+ * `test 1` repeats the calibration and `test 2` plays the driver's own reset,
+ * write and read slots, both on the BSRR path (ds18_test_burn/_slots()).
  */
 
 #include "ds18_local.h"
@@ -42,25 +48,56 @@
 #include "periph/gpio.h"
 #include "ztimer.h"
 
+#include <string.h>
+
+#if IS_USED(MODULE_MFM_SIM)
+#include "mfm_sim.h"
+#endif
+
 #define ENABLE_DEBUG 0
 #include "debug.h"
 
-static void ds18_low(const ds18_t *dev) {
-    /* Set gpio as output and clear pin */
-    gpio_init(dev->params.pin, GPIO_OUT);
-    gpio_clear(dev->params.pin);
+#if IS_USED(MODULE_MFM_SIM)
+/* Host-native build: the bit slots are played against the simulated DS18B20s
+ * instead of a GPIO. Everything from the byte level up is shared. */
+static void ds18_write_bit(const ds18_t *dev, uint8_t bit) {
+    ds18_sim_write_bit(dev->params.pin, bit);
+}
+
+static int ds18_read_bit(const ds18_t *dev, uint8_t *bit) {
+    *bit = ds18_sim_read_bit(dev->params.pin);
+    return DS18_OK;
+}
+
+static int ds18_reset(const ds18_t *dev) {
+    return ds18_sim_reset(dev->params.pin);
+}
+#else
+/* Same split of a pin into port and bit as the stm32 gpio driver */
+static GPIO_TypeDef *ds18_port(gpio_t pin) {
+    return (GPIO_TypeDef *)(uintptr_t)(pin & ~0x0f);
+}
+
+/* The pin is a true open drain output from ds18_init() on, so an edge is a
+ * single BSRR write with no mode switch inside the timed window. */
+static inline void ds18_low(const ds18_t *dev) {
+    dev->port->BSRR = (uint32_t)dev->pin_mask << 16;
+}
+
+static inline void ds18_release(const ds18_t *dev) {
+    dev->port->BSRR = dev->pin_mask;
 }
 
-static void ds18_release(const ds18_t *dev) {
-    /* Init pin as input */
-    gpio_init(dev->params.pin, dev->params.in_mode);
+static inline uint8_t ds18_sample(const ds18_t *dev) {
+    return (dev->port->IDR & dev->pin_mask) ? 1 : 0;
 }
 
 static void ds18_write_bit(const ds18_t *dev, uint8_t bit) {
     unsigned state = irq_disable();
 
-    /* Initiate write slot */
+    /* Initiate write slot, the low pulse must last at least 1 us */
     ds18_low(dev);
+    DS18_DELAY_US(DS18_DELAY_RW_PULSE);
 
     /* Release pin when bit==1 */
     if (bit) {
@@ -68,7 +105,7 @@ static void ds18_write_bit(const ds18_t *dev, uint8_t bit) {
     }
 
     /* Hold for the slot duration */
-    DS18_DELAY_US(DS18_DELAY_SLOT);
+    DS18_DELAY_US(DS18_DELAY_SLOT - DS18_DELAY_RW_PULSE);
     ds18_release(dev);
 
     irq_restore(state);
@@ -82,11 +119,12 @@ static int ds18_read_bit(const ds18_t *dev, uint8_t *bit) {
 
     /* Initiate read slot */
     ds18_low(dev);
+    DS18_DELAY_US(DS18_DELAY_RW_PULSE);
     ds18_release(dev);
 
     /* Wait until the sample point, read, then finish the slot */
-    DS18_DELAY_US(DS18_SAMPLE_TIME);
-    *bit = gpio_read(dev->params.pin);
+    DS18_DELAY_US(DS18_SAMPLE_TIME - DS18_DELAY_RW_PULSE);
+    *bit = ds18_sample(dev);
 
     irq_restore(state);
 
@@ -94,6 +132,51 @@ static int ds18_read_bit(const ds18_t *dev, uint8_t *bit) {
     return DS18_OK;
 }
 
+static int ds18_reset(const ds18_t *dev) {
+    int res;
+
+    /* Reset pulse low; timing isn't sub-us-critical (must be >= 480 us)
+     * so we can keep IRQs enabled here. */
+    ds18_low(dev);
+    DS18_DELAY_US(DS18_DELAY_RESET);
+    ds18_release(dev);
+
+    /* Presence sample point — mask IRQs to keep the 60us point accurate */
+    unsigned state = irq_disable();
+    DS18_DELAY_US(DS18_DELAY_PRESENCE);
+    res = ds18_sample(dev);
+    irq_restore(state);
+
+    /* Tail of the reset slot */
+    DS18_DELAY_US(DS18_DELAY_RESET);
+
+    return res;
+}
+
+void ds18_test_burn(const ds18_t *dev, uint32_t loops, uint32_t edges) {
+    unsigned state = irq_disable();
+    for (uint32_t i = 0; i < edges; i += 2) {
+        ds18_low(dev);
+        if (loops > 0) {
+            ds18_burn_loops(loops);
+        }
+        ds18_release(dev);
+        if (loops > 0) {
+            ds18_burn_loops(loops);
+        }
+    }
+    irq_restore(state);
+}
+
+void ds18_test_slots(const ds18_t *dev) {
+    uint8_t bit;
+    ds18_reset(dev);
+    ds18_write_bit(dev, 0);
+    ds18_write_bit(dev, 1);
+    ds18_read_bit(dev, &bit);
+}
+#endif
+
 static int ds18_read_byte(const ds18_t *dev, uint8_t *byte) {
     uint8_t bit = 0;
     *byte       = 0;
@@ -115,25 +198,104 @@ static void ds18_write_byte(const ds18_t *dev, uint8_t byte) {
     }
 }
 
-static int ds18_reset(const ds18_t *dev) {
-    int res;
+/* Dallas/Maxim CRC-8, x^8 + x^5 + x^4 + 1 (reflected 0x8C), four bits per
+ * step. A 16 byte table is the sweet spot on the M0+: the 256 byte one would
+ * only save two shifts per byte. */
+static const uint8_t ds18_crc8_nibble[16] = {
+    0x00, 0x9d, 0x23, 0xbe, 0x46, 0xdb, 0x65, 0xf8, 0x8c, 0x11, 0xaf, 0x32, 0xca, 0x57, 0xe9, 0x74,
+};
+
+static uint8_t ds18_crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    while (len--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ ds18_crc8_nibble[crc & 0x0f];
+        crc = (crc >> 4) ^ ds18_crc8_nibble[crc & 0x0f];
+    }
+    return crc;
+}
 
-    /* Reset pulse low; timing isn't sub-us-critical (must be >= 480 us)
-     * so we can keep IRQs enabled here. */
-    ds18_low(dev);
-    DS18_DELAY_US(DS18_DELAY_RESET);
-    ds18_release(dev);
+/* Resets the bus and addresses the cached device @p index, or every device
+ * with SKIP ROM when @p index is negative. */
+static int ds18_select(const ds18_t *dev, int index) {
+    if (ds18_reset(dev)) {
+        return DS18_ERROR;
+    }
 
-    /* Presence sample point — mask IRQs to keep the 60us point accurate */
-    unsigned state = irq_disable();
-    DS18_DELAY_US(DS18_DELAY_PRESENCE);
-    res = gpio_read(dev->params.pin);
-    irq_restore(state);
+    if (index < 0) {
+        ds18_write_byte(dev, DS18_CMD_SKIPROM);
+        return DS18_OK;
+    }
 
-    /* Tail of the reset slot */
-    DS18_DELAY_US(DS18_DELAY_RESET);
+    ds18_write_byte(dev, DS18_CMD_MATCHROM);
+    for (unsigned i = 0; i < DS18_ROM_LEN; i++) {
+        ds18_write_byte(dev, dev->rom[index].id[i]);
+    }
+    return DS18_OK;
+}
 
-    return res;
+int ds18_search(ds18_t *dev) {
+    uint8_t rom[DS18_ROM_LEN] = {0};
+    int last_discrepancy      = -1;
+    uint8_t count             = 0;
+
+    dev->count = 0;
+    do {
+        if (ds18_reset(dev)) {
+            return DS18_ERROR;
+        }
+        ds18_write_byte(dev, DS18_CMD_SEARCHROM);
+
+        /* Every ROM bit is read from all remaining devices, then as its
+         * complement. 0/0 means devices disagree: take 1 at the last branch
+         * point, 0 past it, and the previous path before it. */
+        int discrepancy = -1;
+        for (int pos = 0; pos < (int)(DS18_ROM_LEN * 8); pos++) {
+            uint8_t bit = 0, complement = 0;
+            if (ds18_read_bit(dev, &bit) != DS18_OK || ds18_read_bit(dev, &complement) != DS18_OK) {
+                return DS18_ERROR;
+            }
+            if (bit && complement) {
+                DEBUG("[DS18] Search lost all devices at bit %d\n", pos);
+                return DS18_ERROR;
+            }
+
+            uint8_t mask = 1 << (pos % 8);
+            if (bit == complement) {
+                if (pos == last_discrepancy) {
+                    bit = 1;
+                } else if (pos > last_discrepancy) {
+                    bit = 0;
+                } else {
+                    bit = (rom[pos / 8] & mask) != 0;
+                }
+                if (!bit) {
+                    discrepancy = pos;
+                }
+            }
+
+            if (bit) {
+                rom[pos / 8] |= mask;
+            } else {
+                rom[pos / 8] &= ~mask;
+            }
+            ds18_write_bit(dev, bit);
+        }
+
+        if (ds18_crc8(rom, DS18_ROM_LEN - 1) != rom[DS18_ROM_LEN - 1]) {
+            DEBUG("[DS18] ROM CRC mismatch\n");
+            return DS18_ERROR;
+        }
+        if (count == CONFIG_DS18_MAX_DEVICES) {
+            DEBUG("[DS18] More devices than CONFIG_DS18_MAX_DEVICES\n");
+            break;
+        }
+        memcpy(dev->rom[count++].id, rom, DS18_ROM_LEN);
+        last_discrepancy = discrepancy;
+    } while (last_discrepancy >= 0);
+
+    dev->count = count;
+    return count;
 }
 
 int ds18_trigger(const ds18_t *dev) {
@@ -152,49 +314,429 @@ int ds18_trigger(const ds18_t *dev) {
     return DS18_OK;
 }
 
-int ds18_read(const ds18_t *dev, int16_t *temperature) {
-    int res;
-    uint8_t b1 = 0, b2 = 0;
+int ds18_is_converting(const ds18_t *dev) {
+    uint8_t bit = 0;
+    if (ds18_read_bit(dev, &bit) != DS18_OK) {
+        return DS18_ERROR;
+    }
+    return !bit;
+}
+
+int ds18_wait_conversion(const ds18_t *dev, uint32_t timeout_ms) {
+    uint32_t start = ztimer_now(ZTIMER_MSEC);
+    while (1) {
+        int res = ds18_is_converting(dev);
+        if (res <= 0) {
+            return res;
+        }
+        if (ztimer_now(ZTIMER_MSEC) - start >= timeout_ms) {
+            DEBUG("[DS18] Conversion timed out\n");
+            return DS18_ERROR;
+        }
+        ztimer_sleep(ZTIMER_MSEC, DS18_POLL_INTERVAL_MS);
+    }
+}
+
+static int ds18_scratchpad_check(const uint8_t *scratchpad) {
+    DEBUG("[DS18] Received temperature: 0x%02x%02x\n", scratchpad[1], scratchpad[0]);
+
+    uint8_t any = 0;
+    for (unsigned i = 0; i < DS18_SCRATCHPAD_LEN; i++) {
+        any |= scratchpad[i];
+    }
 
+    /* All zeros passes the CRC, but is a bus held low (or nobody there) */
+    if (!any || ds18_crc8(scratchpad, DS18_SCRATCHPAD_LEN - 1) != scratchpad[DS18_SCRATCHPAD_LEN - 1]) {
+        DEBUG("[DS18] Scratchpad CRC mismatch\n");
+        return DS18_ERROR;
+    }
+    return DS18_OK;
+}
+
+static int16_t ds18_scratchpad_temperature(const ds18_t *dev, const uint8_t *scratchpad) {
+    /* The low bits are undefined below 12 bit resolution */
+    int32_t measurement = (int16_t)((scratchpad[1] << 8 | scratchpad[0]) &
+                                    ~((1 << (DS18_RESOLUTION_MAX - dev->resolution)) - 1));
+    return (int16_t)((100 * measurement) >> 4);
+}
+
+static int ds18_read_scratchpad_once(const ds18_t *dev, int index, uint8_t *scratchpad) {
     DEBUG("[DS18] Reset and read scratchpad\n");
-    res = ds18_reset(dev);
-    if (res) {
+    if (ds18_select(dev, index)) {
         return DS18_ERROR;
     }
 
-    ds18_write_byte(dev, DS18_CMD_SKIPROM);
     ds18_write_byte(dev, DS18_CMD_RSCRATCHPAD);
 
-    if (ds18_read_byte(dev, &b1) != DS18_OK) {
-        DEBUG("[DS18] Error reading temperature byte 1\n");
+    for (unsigned i = 0; i < DS18_SCRATCHPAD_LEN; i++) {
+        if (ds18_read_byte(dev, &scratchpad[i]) != DS18_OK) {
+            DEBUG("[DS18] Error reading scratchpad byte %u\n", i);
+            return DS18_ERROR;
+        }
+    }
+
+    return ds18_scratchpad_check(scratchpad);
+}
+
+/* The conversion result stays in the scratchpad, so a corrupted read is
+ * retried on its own without converting again. */
+static int ds18_read_scratchpad(ds18_t *dev, int index, int16_t *temperature) {
+    uint8_t scratchpad[DS18_SCRATCHPAD_LEN];
+
+    dev->stats.reads++;
+    for (unsigned attempt = 0;; attempt++) {
+        if (ds18_read_scratchpad_once(dev, index, scratchpad) == DS18_OK) {
+            break;
+        }
+        if (attempt == CONFIG_DS18_READ_RETRIES) {
+            dev->stats.failures++;
+            return DS18_ERROR;
+        }
+        dev->stats.retries++;
+    }
+
+    *temperature = ds18_scratchpad_temperature(dev, scratchpad);
+    return DS18_OK;
+}
+
+int ds18_read(ds18_t *dev, int16_t *temperature) {
+    return ds18_read_scratchpad(dev, dev->count > 0 ? 0 : -1, temperature);
+}
+
+int ds18_read_index(ds18_t *dev, uint8_t index, int16_t *temperature) {
+    if (index >= dev->count) {
+        return DS18_ERROR;
+    }
+    return ds18_read_scratchpad(dev, index, temperature);
+}
+
+int ds18_read_all(ds18_t *dev, int16_t *temperatures) {
+    if (dev->count == 0) {
+        return ds18_read_scratchpad(dev, -1, temperatures) == DS18_OK ? 1 : DS18_ERROR;
+    }
+
+    for (uint8_t i = 0; i < dev->count; i++) {
+        if (ds18_read_scratchpad(dev, i, &temperatures[i]) != DS18_OK) {
+            return DS18_ERROR;
+        }
+    }
+    return dev->count;
+}
+
+/*
+ * Multi-bus mode
+ * --------------
+ * Buses on one GPIO port run their slots in lockstep: one BSRR write starts
+ * the slot on every bus, one more releases the ones writing a 1, and one IDR
+ * read samples them all. The bits are de-interleaved per bus afterwards. A bus
+ * can sit a byte out (it idles released, 1-Wire has no inter-slot timeout),
+ * so MATCH ROM buses and SKIP ROM buses still share the rest of a command.
+ *
+ * On native the slots go to the simulator one bus after the other.
+ */
+typedef struct {
+    ds18_t *const *devs;
+    uint8_t count;
+#if !IS_USED(MODULE_MFM_SIM)
+    GPIO_TypeDef *port;
+    uint16_t pin_mask[CONFIG_DS18_MULTI_MAX];
+#endif
+} ds18_multi_t;
+
+#if IS_USED(MODULE_MFM_SIM)
+static int ds18_multi_init(ds18_multi_t *m, ds18_t *const *devs, uint8_t count) {
+    m->devs  = devs;
+    m->count = count;
+    return DS18_OK;
+}
+
+static uint8_t ds18_multi_reset(const ds18_multi_t *m, uint8_t active) {
+    uint8_t present = 0;
+    for (uint8_t i = 0; i < m->count; i++) {
+        if ((active & (1 << i)) && !ds18_sim_reset(m->devs[i]->params.pin)) {
+            present |= 1 << i;
+        }
+    }
+    return present;
+}
+
+static uint8_t ds18_multi_slot(const ds18_multi_t *m, uint8_t active, uint8_t ones, int reading) {
+    uint8_t sampled = 0;
+    for (uint8_t i = 0; i < m->count; i++) {
+        if (!(active & (1 << i))) {
+            continue;
+        }
+        if (reading) {
+            sampled |= ds18_sim_read_bit(m->devs[i]->params.pin) << i;
+        } else {
+            ds18_sim_write_bit(m->devs[i]->params.pin, ones & (1 << i));
+        }
+    }
+    return sampled;
+}
+#else
+static int ds18_multi_init(ds18_multi_t *m, ds18_t *const *devs, uint8_t count) {
+    m->devs  = devs;
+    m->count = count;
+    m->port  = devs[0]->port;
+    for (uint8_t i = 0; i < count; i++) {
+        if (devs[i]->port != m->port) {
+            DEBUG("[DS18] Multi-bus pins must share a port\n");
+            return DS18_ERROR;
+        }
+        m->pin_mask[i] = devs[i]->pin_mask;
+    }
+    return DS18_OK;
+}
+
+static uint32_t ds18_multi_port_bits(const ds18_multi_t *m, uint8_t buses) {
+    uint32_t bits = 0;
+    for (uint8_t i = 0; i < m->count; i++) {
+        if (buses & (1 << i)) {
+            bits |= m->pin_mask[i];
+        }
+    }
+    return bits;
+}
+
+/* De-interleaves a port sample into one bit per bus */
+static uint8_t ds18_multi_sampled(const ds18_multi_t *m, uint8_t active, uint32_t idr) {
+    uint8_t sampled = 0;
+    for (uint8_t i = 0; i < m->count; i++) {
+        if ((active & (1 << i)) && (idr & m->pin_mask[i])) {
+            sampled |= 1 << i;
+        }
+    }
+    return sampled;
+}
+
+static uint8_t ds18_multi_reset(const ds18_multi_t *m, uint8_t active) {
+    uint32_t bits = ds18_multi_port_bits(m, active);
+
+    m->port->BSRR = bits << 16;
+    DS18_DELAY_US(DS18_DELAY_RESET);
+    m->port->BSRR = bits;
+
+    unsigned state = irq_disable();
+    DS18_DELAY_US(DS18_DELAY_PRESENCE);
+    uint32_t idr = m->port->IDR;
+    irq_restore(state);
+
+    DS18_DELAY_US(DS18_DELAY_RESET);
+
+    /* Presence pulls the bus low */
+    return active & ~ds18_multi_sampled(m, active, idr);
+}
+
+/* One time slot on every @p active bus. The buses in @p ones write a 1 (or
+ * read), the others a 0. Returns the sampled bits. */
+static uint8_t ds18_multi_slot(const ds18_multi_t *m, uint8_t active, uint8_t ones, int reading) {
+    (void)reading;
+    GPIO_TypeDef *port = m->port;
+    uint32_t low       = ds18_multi_port_bits(m, active);
+    uint32_t release   = ds18_multi_port_bits(m, active & ones);
+
+    unsigned state = irq_disable();
+    port->BSRR     = low << 16;
+    DS18_DELAY_US(DS18_DELAY_RW_PULSE);
+    port->BSRR = release;
+    DS18_DELAY_US(DS18_SAMPLE_TIME - DS18_DELAY_RW_PULSE);
+    uint32_t idr = port->IDR;
+    if (release != low) {
+        /* Someone writes a 0, hold it for the rest of the slot */
+        DS18_DELAY_US(DS18_DELAY_SLOT - DS18_SAMPLE_TIME);
+        port->BSRR = low;
+        irq_restore(state);
+    } else {
+        irq_restore(state);
+        DS18_DELAY_US(DS18_DELAY_R_RECOVER);
+    }
+    DS18_DELAY_US(DS18_DELAY_RW_PULSE);
+
+    return ds18_multi_sampled(m, active, idr);
+}
+#endif
+
+static void ds18_multi_write_bytes(const ds18_multi_t *m, uint8_t active, const uint8_t *bytes) {
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        uint8_t ones = 0;
+        for (uint8_t i = 0; i < m->count; i++) {
+            ones |= ((bytes[i] >> bit) & 0x01) << i;
+        }
+        ds18_multi_slot(m, active, ones, 0);
+    }
+}
+
+static void ds18_multi_write_all(const ds18_multi_t *m, uint8_t active, uint8_t byte) {
+    uint8_t bytes[CONFIG_DS18_MULTI_MAX];
+    memset(bytes, byte, sizeof(bytes));
+    ds18_multi_write_bytes(m, active, bytes);
+}
+
+static void ds18_multi_read_bytes(const ds18_multi_t *m, uint8_t active, uint8_t *bytes) {
+    uint8_t slots[8];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        slots[bit] = ds18_multi_slot(m, active, active, 1);
+    }
+
+    for (uint8_t i = 0; i < m->count; i++) {
+        bytes[i] = 0;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            bytes[i] |= ((slots[bit] >> i) & 0x01) << bit;
+        }
+    }
+}
+
+/* Resets the @p active buses and addresses the first cached device on each,
+ * or all devices with SKIP ROM. Returns the buses that answered. */
+static uint8_t ds18_multi_select(const ds18_multi_t *m, uint8_t active) {
+    uint8_t present = ds18_multi_reset(m, active);
+    uint8_t match   = 0;
+    uint8_t bytes[CONFIG_DS18_MULTI_MAX];
+
+    for (uint8_t i = 0; i < m->count; i++) {
+        if (m->devs[i]->count > 0) {
+            bytes[i] = DS18_CMD_MATCHROM;
+            match |= 1 << i;
+        } else {
+            bytes[i] = DS18_CMD_SKIPROM;
+        }
+    }
+    ds18_multi_write_bytes(m, present, bytes);
+
+    match &= present;
+    if (match) {
+        for (unsigned b = 0; b < DS18_ROM_LEN; b++) {
+            for (uint8_t i = 0; i < m->count; i++) {
+                bytes[i] = m->devs[i]->rom[0].id[b];
+            }
+            ds18_multi_write_bytes(m, match, bytes);
+        }
+    }
+    return present;
+}
+
+static int ds18_multi_open(ds18_multi_t *m, ds18_t *const *devs, uint8_t count) {
+    if (count == 0 || count > CONFIG_DS18_MULTI_MAX) {
+        return DS18_ERROR;
+    }
+    return ds18_multi_init(m, devs, count);
+}
+
+int ds18_multi_trigger(ds18_t *const *devs, uint8_t count) {
+    ds18_multi_t m;
+    if (ds18_multi_open(&m, devs, count)) {
+        return DS18_ERROR;
+    }
+
+    uint8_t all     = (1 << count) - 1;
+    uint8_t present = ds18_multi_reset(&m, all);
+    ds18_multi_write_all(&m, present, DS18_CMD_SKIPROM);
+    ds18_multi_write_all(&m, present, DS18_CMD_CONVERT);
+
+    return all & ~present;
+}
+
+int ds18_multi_converting(ds18_t *const *devs, uint8_t count) {
+    ds18_multi_t m;
+    if (ds18_multi_open(&m, devs, count)) {
         return DS18_ERROR;
     }
 
-    DEBUG("[DS18] Received byte: 0x%02x\n", b1);
+    uint8_t all  = (1 << count) - 1;
+    uint8_t done = ds18_multi_slot(&m, all, all, 1);
+
+    return all & ~done;
+}
 
-    if (ds18_read_byte(dev, &b2) != DS18_OK) {
-        DEBUG("[DS18] Error reading temperature byte 2\n");
+int ds18_multi_read(ds18_t *const *devs, uint8_t count, int16_t *temperatures) {
+    ds18_multi_t m;
+    if (ds18_multi_open(&m, devs, count)) {
         return DS18_ERROR;
     }
 
-    DEBUG("[DS18] Received byte: 0x%02x\n", b2);
+    uint8_t scratchpads[CONFIG_DS18_MULTI_MAX][DS18_SCRATCHPAD_LEN];
+    uint8_t pending = (1 << count) - 1;
+    for (uint8_t i = 0; i < count; i++) {
+        devs[i]->stats.reads++;
+    }
 
-    int32_t measurement = (int16_t)(b2 << 8 | b1);
-    *temperature        = (int16_t)((100 * measurement) >> 4);
+    /* Like ds18_read(), only the buses that failed the CRC read again */
+    for (unsigned attempt = 0; pending && attempt <= CONFIG_DS18_READ_RETRIES; attempt++) {
+        if (attempt > 0) {
+            for (uint8_t i = 0; i < count; i++) {
+                if (pending & (1 << i)) {
+                    devs[i]->stats.retries++;
+                }
+            }
+        }
 
+        uint8_t active = ds18_multi_select(&m, pending);
+        ds18_multi_write_all(&m, active, DS18_CMD_RSCRATCHPAD);
+        for (unsigned b = 0; b < DS18_SCRATCHPAD_LEN; b++) {
+            uint8_t bytes[CONFIG_DS18_MULTI_MAX];
+            ds18_multi_read_bytes(&m, active, bytes);
+            for (uint8_t i = 0; i < count; i++) {
+                scratchpads[i][b] = bytes[i];
+            }
+        }
+
+        for (uint8_t i = 0; i < count; i++) {
+            if ((active & (1 << i)) && ds18_scratchpad_check(scratchpads[i]) == DS18_OK) {
+                temperatures[i] = ds18_scratchpad_temperature(devs[i], scratchpads[i]);
+                pending &= ~(1 << i);
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (pending & (1 << i)) {
+            devs[i]->stats.failures++;
+        }
+    }
+    return pending;
+}
+
+int ds18_set_resolution(ds18_t *dev, uint8_t bits, int persist) {
+    if (bits < DS18_RESOLUTION_MIN || bits > DS18_RESOLUTION_MAX) {
+        return DS18_ERROR;
+    }
+
+    DEBUG("[DS18] Set resolution to %u bit\n", bits);
+    if (ds18_select(dev, -1)) {
+        return DS18_ERROR;
+    }
+    ds18_write_byte(dev, DS18_CMD_WRITESCRATCHPAD);
+    ds18_write_byte(dev, DS18_ALARM_TH_DEFAULT);
+    ds18_write_byte(dev, DS18_ALARM_TL_DEFAULT);
+    ds18_write_byte(dev, ((bits - DS18_RESOLUTION_MIN) << DS18_CONFIG_RES_SHIFT) | DS18_CONFIG_RESERVED);
+
+    if (persist) {
+        if (ds18_select(dev, -1)) {
+            return DS18_ERROR;
+        }
+        ds18_write_byte(dev, DS18_CMD_COPYSCRATCHPAD);
+        /* EEPROM write, the devices ignore the bus meanwhile */
+        ztimer_sleep(ZTIMER_USEC, DS18_DELAY_COPY);
+    }
+
+    dev->resolution = bits;
     return DS18_OK;
 }
 
-int ds18_get_temperature(const ds18_t *dev, int16_t *temperature) {
+int ds18_get_temperature(ds18_t *dev, int16_t *temperature) {
 
     DEBUG("[DS18] Convert T\n");
     if (ds18_trigger(dev)) {
         return DS18_ERROR;
     }
 
-    /* Long delay — keep on ztimer so the CPU can sleep */
+    /* Poll for completion, sleeping on ztimer in between so the CPU can
+     * sleep. The slack covers the first poll landing late. */
     DEBUG("[DS18] Wait for convert T\n");
-    ztimer_sleep(ZTIMER_USEC, DS18_DELAY_CONVERT);
+    if (ds18_wait_conversion(dev, DS18_CONVERT_MS(dev->resolution) + DS18_POLL_INTERVAL_MS)) {
+        return DS18_ERROR;
+    }
 
     return ds18_read(dev, temperature);
 }
@@ -202,14 +744,25 @@ int ds18_get_temperature(const ds18_t *dev, int16_t *temperature) {
 int ds18_init(ds18_t *dev, const ds18_params_t *params) {
     int res;
 
-    dev->params = *params;
+    dev->params     = *params;
+    dev->count      = 0;
+    dev->resolution = DS18_RESOLUTION_MAX; /* Power-up default, unless persisted otherwise */
 
     /* Deduct the input mode from the output mode. If pull-up resistors are
      * used for output then will be used for input as well. */
     dev->params.in_mode = (dev->params.out_mode == GPIO_OD_PU) ? GPIO_IN_PU : GPIO_IN;
 
-    /* Initialize the device and the pin */
-    res = gpio_init(dev->params.pin, dev->params.in_mode) == 0 ? DS18_OK : DS18_ERROR;
+#if IS_USED(MODULE_MFM_SIM)
+    res = DS18_OK;
+#else
+    /* Open drain output for good, released: set the latch before the mode
+     * so the switch does not pull the bus low for a moment. */
+    gpio_mode_t mode = (dev->params.out_mode == GPIO_OD_PU) ? GPIO_OD_PU : GPIO_OD;
+    dev->port        = ds18_port(dev->params.pin);
+    dev->pin_mask    = 1 << (dev->params.pin & 0x0f);
+    ds18_release(dev);
+    res = gpio_init(dev->params.pin, mode) == 0 ? DS18_OK : DS18_ERROR;
+#endif
 
     return res;
 }
@@ -36,7 +36,6 @@ extern "C" {
 #define DS18_CMD_SEARCHROM          (0xf0)
 #define DS18_CMD_READROM            (0x33)
 #define DS18_CMD_MATCHROM           (0x55)
-#define DS18_CMD_SEARCHROM          (0xf0)
 #define DS18_CMD_ALARMSEARCH        (0xec)
 #define DS18_CMD_SKIPROM            (0xcc)
 /** @} */
@@ -52,6 +51,23 @@ extern "C" {
 #define DS18_DELAY_CONVERT          (750U * US_PER_MS)
 #define DS18_DELAY_RW_PULSE         (1U)
 #define DS18_DELAY_R_RECOVER        (DS18_DELAY_SLOT - DS18_SAMPLE_TIME)
+#define DS18_DELAY_COPY             (10U * US_PER_MS)
+#define DS18_POLL_INTERVAL_MS       (10U)
+/** @} */
+
+/**
+ * @brief Scratchpad length, the last byte is the CRC-8 of the others
+ */
+#define DS18_SCRATCHPAD_LEN         (9U)
+
+/**
+ * @name ds18 configuration register
+ * @{
+ */
+#define DS18_CONFIG_RES_SHIFT       (5U)
+#define DS18_CONFIG_RESERVED        (0x1f)
+#define DS18_ALARM_TH_DEFAULT       (0x4b)
+#define DS18_ALARM_TL_DEFAULT       (0x46)
 /** @} */
 
 #ifdef __cplusplus
@@ -16,9 +16,10 @@
  *
  * This driver provides @ref drivers_saul capabilities.
  * Currently the driver has the following limitations:
- *- Does not allow addressing devices, only supports a single device on the bus.
+ *- Devices are only addressed once the bus was enumerated with ds18_search(),
+ *  until then a single device per bus is assumed (SKIP ROM).
  *- The 1-Wire bus handling is hardcoded to the driver.
- *- Does not allow configuration of sampling width.
+ *- The resolution set with ds18_set_resolution() applies to the whole bus.
  *
  * @note Due to timing issues present on some boards this drivers features two
  * ways of reading information from the sensor. The optimized uses accurate
@@ -39,6 +40,7 @@
 
 #include <stdint.h>
 
+#include "kernel_defines.h"
 #include "periph/gpio.h"
 #include "periph_cpu.h"
 
@@ -58,6 +60,18 @@ extern "C" {
  * @name 1-Wire busy-wait timing primitive (see ds18.c for calibration notes)
  * @{
  */
+#ifdef CPU_NATIVE
+/* Host-native build: the bus is simulated, there is nothing to time. Keep a
+ * plain loop so the shell timing tests still build. */
+#define DS18_BURN_LOOPS(us) ((uint32_t)(us))
+
+static inline void ds18_burn_loops(uint32_t loops)
+{
+    while (loops--) {
+        __asm__ volatile("");
+    }
+}
+#else
 #define DS18_BURN_CYCLES_PER_LOOP   3U
 #define DS18_BURN_LOOPS(us) \
     (((uint32_t)(us) * (CLOCK_CORECLOCK / 1000000U) \
@@ -70,6 +84,7 @@ static inline __attribute__((always_inline)) void ds18_burn_loops(uint32_t loops
                      "   bne  1b\n"
                      : "+l"(loops)::"cc");
 }
+#endif
 
 /** Busy-wait `us` microseconds. Loop count is constant-folded when `us` is. */
 #define DS18_DELAY_US(us) ds18_burn_loops(DS18_BURN_LOOPS(us))
@@ -85,10 +100,75 @@ typedef struct {
 } ds18_params_t;
 
 /**
- * @brief   Device descriptor for a ds18 device
+ * @brief Length of a 1-Wire ROM code (family, 48 bit serial, CRC)
+ */
+#define DS18_ROM_LEN                (8U)
+
+/**
+ * @name Conversion resolution
+ * @{
+ */
+#define DS18_RESOLUTION_MIN         (9U)
+#define DS18_RESOLUTION_MAX         (12U)
+/** Conversion time at @p bits resolution in us, 93750 us at 9 bit doubling up to 750 ms */
+#define DS18_CONVERT_US(bits)       ((750000UL) >> (DS18_RESOLUTION_MAX - (bits)))
+/** Conversion time at @p bits resolution in ms, rounded up (94/188/375/750) */
+#define DS18_CONVERT_MS(bits)       ((DS18_CONVERT_US(bits) + 999U) / 1000U)
+/** @} */
+
+/**
+ * @brief Number of ROM codes cached per bus
+ */
+#ifndef CONFIG_DS18_MAX_DEVICES
+#define CONFIG_DS18_MAX_DEVICES     (4U)
+#endif
+
+/**
+ * @brief Number of buses one ds18_multi_* call can drive in lockstep (max 8)
+ */
+#ifndef CONFIG_DS18_MULTI_MAX
+#define CONFIG_DS18_MULTI_MAX       (2U)
+#endif
+
+/**
+ * @brief Scratchpad read retries after a CRC mismatch, before giving up
+ */
+#ifndef CONFIG_DS18_READ_RETRIES
+#define CONFIG_DS18_READ_RETRIES    (2U)
+#endif
+
+/**
+ * @brief Scratchpad read counters of a bus, to track its quality
  */
 typedef struct {
-    ds18_params_t params;   /**< Device Parameters */
+    uint32_t reads;     /**< Temperature reads */
+    uint32_t retries;   /**< Scratchpad reads repeated after a CRC or bus error */
+    uint32_t failures;  /**< Reads that failed after all retries */
+} ds18_stats_t;
+
+/**
+ * @brief 1-Wire ROM code of a device, LSB (family code) first
+ */
+typedef struct {
+    uint8_t id[DS18_ROM_LEN];   /**< ROM bytes as sent on the bus */
+} ds18_rom_t;
+
+/**
+ * @brief   Device descriptor for a ds18 bus
+ *
+ * One descriptor serves every device on its pin. Without a ROM search
+ * (@p count == 0) commands go to the bus with SKIP ROM.
+ */
+typedef struct {
+    ds18_params_t params;                       /**< Device Parameters */
+    ds18_rom_t rom[CONFIG_DS18_MAX_DEVICES];    /**< ROM cache, filled by ds18_search() */
+    uint8_t count;                              /**< Number of cached ROMs */
+    uint8_t resolution;                         /**< Conversion resolution in bits */
+    ds18_stats_t stats;                         /**< Read counters, kept across ds18_init() */
+#if !IS_USED(MODULE_MFM_SIM)
+    GPIO_TypeDef *port;                         /**< Port of the pin, for single write bit edges */
+    uint16_t pin_mask;                          /**< Bit of the pin in @p port */
+#endif
 } ds18_t;
 
 /**
@@ -115,30 +195,194 @@ int ds18_init(ds18_t *dev, const ds18_params_t *params);
 int ds18_trigger(const ds18_t *dev);
 
 /**
- * @brief Reads the scratchpad for the last conversion
+ * @brief Checks whether the conversion started by ds18_trigger() still runs
+ *
+ * Issues one read time slot, which the devices hold low while converting.
+ * Only valid between ds18_trigger() and the next reset of the bus, and with
+ * externally powered devices (parasite powered ones cannot signal).
  *
  * @param[in] dev           device descriptor
+ *
+ * @return                  1 while any device converts, 0 once all are done
+ * @return                 -1 on error
+ */
+int ds18_is_converting(const ds18_t *dev);
+
+/**
+ * @brief Waits for the conversion started by ds18_trigger() to complete
+ *
+ * Polls with ds18_is_converting() every DS18_POLL_INTERVAL_MS and sleeps on
+ * ztimer in between, so it returns as soon as the devices are done instead of
+ * after the worst case conversion time.
+ *
+ * @param[in] dev           device descriptor
+ * @param[in] timeout_ms    give up after this long
+ *
+ * @return                  0 on success
+ * @return                 -1 on error or timeout
+ */
+int ds18_wait_conversion(const ds18_t *dev, uint32_t timeout_ms);
+
+/**
+ * @brief Reads the scratchpad for the last conversion
+ *
+ * Addresses the first cached device when the bus was enumerated. All nine
+ * bytes are read and checked against their CRC-8, a mismatch repeats the read
+ * up to CONFIG_DS18_READ_RETRIES times (counted in @p dev stats).
+ *
+ * @param[inout] dev        device descriptor
  * @param[out] temperature  buffer to write the temperature in centi-degrees
  *
  * @return                  0 on success
  * @return                 -1 on error
  */
-int ds18_read(const ds18_t *dev, int16_t *temperature);
+int ds18_read(ds18_t *dev, int16_t *temperature);
+
+/**
+ * @brief Enumerates the devices on the bus with SEARCH ROM
+ *
+ * Fills the ROM cache of @p dev in search order. Devices beyond
+ * CONFIG_DS18_MAX_DEVICES are not cached. On error the cache is left empty,
+ * so the bus falls back to SKIP ROM.
+ *
+ * @param[inout] dev        device descriptor
+ *
+ * @return                  number of devices found
+ * @return                 -1 on error (no presence, or a broken ROM code)
+ */
+int ds18_search(ds18_t *dev);
+
+/**
+ * @brief Reads the scratchpad of one cached device, addressed with MATCH ROM
+ *
+ * @param[inout] dev        device descriptor
+ * @param[in] index         index into the ROM cache
+ * @param[out] temperature  buffer to write the temperature in centi-degrees
+ *
+ * @return                  0 on success
+ * @return                 -1 on error
+ */
+int ds18_read_index(ds18_t *dev, uint8_t index, int16_t *temperature);
+
+/**
+ * @brief Reads back every cached device after one broadcast ds18_trigger()
+ *
+ * Falls back to a single SKIP ROM read when the bus was not enumerated.
+ *
+ * @param[inout] dev        device descriptor
+ * @param[out] temperatures one entry per cached device (at least one)
+ *
+ * @return                  number of temperatures read
+ * @return                 -1 on error
+ */
+int ds18_read_all(ds18_t *dev, int16_t *temperatures);
+
+/**
+ * @name Multi-bus mode
+ *
+ * Runs the same command on up to CONFIG_DS18_MULTI_MAX buses at once. The
+ * pins of @p devs must be on the same GPIO port: every bit slot is a single
+ * port write on all buses and a single port read, so two buses cost the bus
+ * time of one. Results are masks with bit n standing for devs[n].
+ * @{
+ */
+
+/**
+ * @brief ds18_trigger() on every bus of @p devs at once
+ *
+ * @return                  mask of the buses without presence
+ * @return                 -1 on error (too many buses, pins on several ports)
+ */
+int ds18_multi_trigger(ds18_t *const *devs, uint8_t count);
+
+/**
+ * @brief ds18_is_converting() on every bus of @p devs with one read slot
+ *
+ * @return                  mask of the buses still converting
+ * @return                 -1 on error
+ */
+int ds18_multi_converting(ds18_t *const *devs, uint8_t count);
+
+/**
+ * @brief ds18_read() on every bus of @p devs at once
+ *
+ * Reads the first cached device of each bus, or its only one (SKIP ROM),
+ * with the same CRC check and retries as ds18_read().
+ *
+ * @param[inout] devs       buses
+ * @param[in] count         number of buses
+ * @param[out] temperatures one entry per bus, left alone for failed buses
+ *
+ * @return                  mask of the buses that failed
+ * @return                 -1 on error
+ */
+int ds18_multi_read(ds18_t *const *devs, uint8_t count, int16_t *temperatures);
+/** @} */
+
+/**
+ * @brief Sets the conversion resolution of every device on the bus
+ *
+ * Writes the configuration register with WRITE SCRATCHPAD (SKIP ROM), the
+ * alarm registers are set to their factory values. Without @p persist the
+ * devices return to the resolution in their EEPROM on power loss, so call
+ * this after every power-up rather than wearing the EEPROM.
+ *
+ * @param[inout] dev        device descriptor
+ * @param[in] bits          resolution, 9 to 12 bit (0.5 to 0.0625 C)
+ * @param[in] persist       also COPY SCRATCHPAD into the EEPROM
+ *
+ * @return                  0 on success
+ * @return                 -1 on error
+ */
+int ds18_set_resolution(ds18_t *dev, uint8_t bits, int persist);
+
+/**
+ * @brief Conversion time of the bus at its current resolution
+ *
+ * @param[in] dev           device descriptor
+ *
+ * @return                  conversion time in ms
+ */
+static inline uint32_t ds18_conversion_ms(const ds18_t *dev)
+{
+    return DS18_CONVERT_MS(dev->resolution);
+}
 
 /**
  * @brief   convenience function for triggering a conversion and reading the
  * value
  *
- * @note This function will block for the conversion time. The current
- * implementation of the driver uses 12-bit resolution, so this time is 750 ms.
+ * @note This function blocks until the conversion completed, at most for the
+ * conversion time of the resolution (750 ms at the default 12 bit, see
+ * ds18_set_resolution()).
  *
- * @param[in] dev           device descriptor
+ * @param[inout] dev        device descriptor
  * @param[out] temperature  buffer to write the temperature in centi-degrees
  *
  * @return                   0 on success
  * @return                  -1 on error
  */
-int ds18_get_temperature(const ds18_t *dev, int16_t *temperature);
+int ds18_get_temperature(ds18_t *dev, int16_t *temperature);
+
+#if !IS_USED(MODULE_MFM_SIM)
+/**
+ * @brief Toggles the bus for a scope, IRQs masked: @p edges edges with
+ * ds18_burn_loops(@p loops) after each, 0 for the bare BSRR writes
+ *
+ * @param[in] dev           device descriptor, after ds18_init()
+ * @param[in] loops         burn loops per half period
+ * @param[in] edges         number of edges
+ */
+void ds18_test_burn(const ds18_t *dev, uint32_t loops, uint32_t edges);
+
+/**
+ * @brief Plays a reset, a write-0, a write-1 and a read slot for a scope,
+ * exactly as the driver times them
+ *
+ * @param[in] dev           device descriptor, after ds18_init()
+ */
+void ds18_test_slots(const ds18_t *dev);
+#endif
 
 #ifdef __cplusplus
 }
@@ -1,6 +1,6 @@
 #include "include/ezoec.h"
-#include "mutex.h"
 #include "periph/uart.h"
+#include "rmutex.h"
 #include "thread.h"
 #include "thread_flags.h"
 #include "tsrb.h"
@@ -16,76 +16,170 @@
 
 #define ASSERT_OK_TIMEOUT 2500
 #define TX_MAX_LINE_LEN   42
-#define MAX_DECIMALS      3
 #define DEV               UART_DEV(ec->params.uart)
 
+#if IS_USED(MODULE_MFM_SIM)
+#include "mfm_sim.h"
+// Host-native build: LPUART1 is backed by the simulated EZO-EC.
+#define EZOEC_UART_INIT(ec, cb)         ezoec_sim_uart_init((ec)->params.baud_rate, (cb), (ec))
+#define EZOEC_UART_WRITE(ec, data, len) ezoec_sim_uart_write((data), (len))
+#elif IS_USED(MODULE_EZOEC_DMA)
+#include "ezoec_dma.h"
+// Reception bypasses the rx callback, see ezoec_dma.c
+#define EZOEC_UART_INIT(ec, cb)         ((void)(cb), ezoec_dma_init(ec))
+#define EZOEC_UART_WRITE(ec, data, len) uart_write(DEV, (data), (len))
+#else
+#define EZOEC_UART_INIT(ec, cb)         uart_init(DEV, (ec)->params.baud_rate, (cb), (ec))
+#define EZOEC_UART_WRITE(ec, data, len) uart_write(DEV, (data), (len))
+#endif
+
+// Receive buffer access: the tsrb filled by the rx callback, or with DMA the
+// circular buffer between our read index and the DMA write position.
+#if IS_USED(MODULE_EZOEC_DMA) && !IS_USED(MODULE_MFM_SIM)
+static inline void _rx_reset(ezoec_t *ec) {
+    ec->rx_tail = ezoec_dma_head(ec);
+    ezoec_parser_reset(&ec->parser);
+}
+static inline int _rx_empty(ezoec_t *ec) { return ec->rx_tail == ezoec_dma_head(ec); }
+static inline int _rx_peek(ezoec_t *ec) { return _rx_empty(ec) ? -1 : ec->rx_buffer[ec->rx_tail]; }
+static inline int _rx_get(ezoec_t *ec) {
+    int data = _rx_peek(ec);
+    if (data >= 0) {
+        ec->rx_tail = (ec->rx_tail + 1) % sizeof(ec->rx_buffer);
+    }
+    return data;
+}
+#else
+static inline void _rx_reset(ezoec_t *ec) {
+    tsrb_clear(&ec->rx_ringbuffer);
+    ezoec_parser_reset(&ec->parser);
+}
+static inline int _rx_empty(ezoec_t *ec) { return tsrb_empty(&ec->rx_ringbuffer); }
+static inline int _rx_peek(ezoec_t *ec) { return tsrb_peek_one(&ec->rx_ringbuffer); }
+static inline int _rx_get(ezoec_t *ec) { return tsrb_get_one(&ec->rx_ringbuffer); }
+#endif
+
 char *_int_to_string(uint8_t k, uint8_t precision);
 
-enum {
-    STATUS_OK,
-    STATUS_ERROR,
-    STATUS_OVERVOLT,
-    STATUS_UNDERVOLT,
-    STATUS_RESET,
-    STATUS_READY,
-    STATUS_SLEEP,
-    STATUS_WAKE,
-    STATUS_DONE,
-} status_t;
-
-#define MAX_STATUS_LEN 6
+static int _next_event(ezoec_t *ec, ezoec_evt_t *evt, uint32_t timeout);
+
+// Waits for the next status line, other lines are skipped.
 static int _read_status(ezoec_t *ec, uint32_t timeout) {
-    // Wait for first status messsage (prefixed by *)
-    while (!tsrb_empty(&ec->rx_ringbuffer) && tsrb_peek_one(&ec->rx_ringbuffer) != '*') {
-        tsrb_get_one(&ec->rx_ringbuffer);
-    }
-
-    char status[MAX_STATUS_LEN] = {0};
-    int len                     = ezoec_readline(ec, status, MAX_STATUS_LEN, timeout);
-    if (len < 0) {
-        return len;
-    }
-    DEBUG("[%s]: %s\n", __func__, status);
-    if (strcmp(status, "*OK") == 0)
-        return STATUS_OK;
-    if (strcmp(status, "*ER") == 0)
-        return STATUS_ERROR;
-    if (strcmp(status, "*OV") == 0)
-        return STATUS_OVERVOLT;
-    if (strcmp(status, "*UV") == 0)
-        return STATUS_UNDERVOLT;
-    if (strcmp(status, "*RS") == 0)
-        return STATUS_RESET;
-    if (strcmp(status, "*RE") == 0)
-        return STATUS_READY;
-    if (strcmp(status, "*SL") == 0)
-        return STATUS_SLEEP;
-    if (strcmp(status, "*WA") == 0)
-        return STATUS_WAKE;
-    if (strcmp(status, "*DONE") == 0)
-        return STATUS_DONE;
-    return -1;
+    ezoec_evt_t evt;
+    for (;;) {
+        int result = _next_event(ec, &evt, timeout);
+        if (result < 0) {
+            return result;
+        }
+        if (evt.type == EZOEC_EVT_STATUS) {
+            DEBUG("[%s]: %d\n", __func__, evt.status);
+            return (evt.status == EZOEC_STATUS_UNKNOWN) ? -1 : (int)evt.status;
+        }
+    }
 }
 
 #define FLAG_RX_DATA (1u << 0)
 static void on_ezoec_receive(void *arg, uint8_t data) {
     ezoec_t *ec = (ezoec_t *)arg;
-    tsrb_add_one(&ec->rx_ringbuffer, data);
-    thread_flags_set(thread_get(ec->rx_thread), FLAG_RX_DATA);
+    // Only wake the reader once there is a full line for it, or when it has
+    // to make room.
+    if (tsrb_add_one(&ec->rx_ringbuffer, data) < 0 || data == '\r' || tsrb_full(&ec->rx_ringbuffer)) {
+        thread_flags_set(thread_get(ec->rx_thread), FLAG_RX_DATA);
+    }
 }
 
-int ezoec_init(ezoec_t *ec, const ezoec_params_t *params) {
-    ec->params = *params;
-    mutex_init(&ec->readline_lock);
+/**
+ * @brief Sets up the UART towards the EZO without talking to it.
+ *
+ * Only flushes the receive buffer when the UART is already set up with the
+ * same parameters.
+ */
+int ezoec_open(ezoec_t *ec, const ezoec_params_t *params) {
+    if ((ec->session & EZOEC_SESSION_OPEN) && ec->params.uart == params->uart &&
+        ec->params.baud_rate == params->baud_rate) {
+        rmutex_lock(&ec->lock);
+        _rx_reset(ec);
+        rmutex_unlock(&ec->lock);
+        return 0;
+    }
+
+    // Reads take the link over, this is just who is woken until the first
+    ec->rx_thread = thread_getpid();
+    ec->session   = 0;
+    ec->params    = *params;
+    rmutex_init(&ec->lock);
 
     tsrb_init(&ec->rx_ringbuffer, ec->rx_buffer, sizeof(ec->rx_buffer));
+    ezoec_parser_reset(&ec->parser);
+    ezoec_parser_set_line(&ec->parser, NULL, 0);
 
-    int result = uart_init(DEV, ec->params.baud_rate, on_ezoec_receive, ec);
+    int result = EZOEC_UART_INIT(ec, on_ezoec_receive);
     if (result < 0) {
         DEBUG("[%s]: Could not init uart at %d: %d\n", __func__, ec->params.baud_rate, result);
         return result;
     }
-    uart_write(DEV, (const uint8_t *)"\r", 1);
+    ec->session = EZOEC_SESSION_OPEN;
+    return 0;
+}
+
+/**
+ * @brief Continues the session from a previous init, only running the full
+ * init handshake when the session was lost.
+ */
+int ezoec_resume(ezoec_t *ec, const ezoec_params_t *params) {
+    int result = ezoec_open(ec, params);
+    if (result < 0) {
+        return result;
+    }
+    if (ec->session & EZOEC_SESSION_ALIVE) {
+        return 0;
+    }
+    DEBUG("[%s]: No session, full init\n", __func__);
+    return ezoec_init(ec, params);
+}
+
+/**
+ * @brief Forces a full init on the next ezoec_resume(), e.g. after the EZO
+ * did not show up on power-up.
+ */
+void ezoec_session_lost(ezoec_t *ec) {
+    if (ec->session & EZOEC_SESSION_ALIVE) {
+        DEBUG("[ezoec]: Session lost\n");
+    }
+    ec->session &= ~EZOEC_SESSION_ALIVE;
+}
+
+/**
+ * @brief Waits for the *RE banner the EZO sends once it has booted.
+ *
+ * Only meaningful right after powering the EZO, call repeatedly with a short
+ * timeout to poll.
+ *
+ * @return 0 once the banner was seen, -ETIMEDOUT if it did not arrive in time.
+ */
+int ezoec_wait_ready(ezoec_t *ec, uint32_t timeout) {
+    uint32_t start = ztimer_now(ZTIMER_MSEC);
+    for (;;) {
+        uint32_t elapsed = ztimer_now(ZTIMER_MSEC) - start;
+        if (elapsed >= timeout) {
+            return -ETIMEDOUT;
+        }
+        // Skip power-up noise and anything else that is not the banner
+        int result = _read_status(ec, timeout - elapsed);
+        if (result == -ETIMEDOUT) {
+            return result;
+        }
+        if (result == EZOEC_STATUS_READY) {
+            DEBUG("[%s]: EZO ready\n", __func__);
+            return 0;
+        }
+    }
+}
+
+static int _handshake(ezoec_t *ec) {
+    int result;
+    ec->session &= ~EZOEC_SESSION_ALIVE;
+    EZOEC_UART_WRITE(ec, (const uint8_t *)"\r", 1);
     ezoec_assert_ok(ec);
 
     char version[15] = {0};
@@ -104,86 +198,161 @@ int ezoec_init(ezoec_t *ec, const ezoec_params_t *params) {
     }
 
     DEBUG("[%s]: Init success\n", __func__);
+    ec->session |= EZOEC_SESSION_ALIVE;
     return 0;
 }
 
+int ezoec_init(ezoec_t *ec, const ezoec_params_t *params) {
+    int result = ezoec_open(ec, params);
+    if (result < 0) {
+        return result;
+    }
+    rmutex_lock(&ec->lock);
+    result = _handshake(ec);
+    rmutex_unlock(&ec->lock);
+    return result;
+}
+
 int ezoec_set_baud(ezoec_t *ec, unsigned int baud) { return ezoec_cmd(ec, 0, NULL, 0, "Baud,%d", baud); }
 
-int ezoec_factory(ezoec_t *ec) {
-    uart_write(DEV, (const uint8_t *)"Factory\r", sizeof("Factory\r"));
+static int _factory(ezoec_t *ec) {
+    ec->cal_fingerprint = 0;
+    EZOEC_UART_WRITE(ec, (const uint8_t *)"Factory\r", sizeof("Factory\r"));
 
     int result = 0;
     // Wait for reset
     result = _read_status(ec, 2000);
     if (result < 0)
         return result;
-    if (result != STATUS_OK)
+    if (result != EZOEC_STATUS_OK)
         return -1;
     result = _read_status(ec, 2000);
     if (result < 0)
         return result;
-    if (result != STATUS_RESET)
+    if (result != EZOEC_STATUS_RESET)
         return -1;
     result = _read_status(ec, 2000);
     if (result < 0)
         return result;
-    if (result != STATUS_READY)
+    if (result != EZOEC_STATUS_READY)
         return -1;
 
     DEBUG("[%s]: EZO ready\n", __func__);
     return 0;
 }
 
+int ezoec_factory(ezoec_t *ec) {
+    rmutex_lock(&ec->lock);
+    int result = _factory(ec);
+    rmutex_unlock(&ec->lock);
+    return result;
+}
+
 int ezoec_set_k(ezoec_t *ec, uint8_t k_value) {
     return ezoec_cmd(ec, 0, NULL, 0, "K,%s", _int_to_string(k_value, 1));
 }
 
-int ezoec_measure(ezoec_t *ec, uint32_t *out_nS) {
-    char rx[RX_MAX_LINE_LEN] = {0};
-    int rx_len               = ezoec_cmd(ec, 2000, rx, sizeof(rx), "R");
-    if (rx_len < 0) {
-        return rx_len;
-    }
-
-    // Convert to int. Stop at first non-digit/non-dot so multi-field
-    // responses (e.g. "100,54" when TDS is enabled) don't corrupt the
-    // value by adding negative ASCII offsets to an unsigned accumulator.
-    char *ptr_start = rx;
-    char *ptr_end   = ptr_start + rx_len;
-    char *ptr       = ptr_start;
-    char *dot       = NULL;
-
-    *out_nS = 0;
-    while (ptr < ptr_end) {
-        if (*ptr == '.') {
-            if (dot != NULL) {
-                return -EINVAL; // Second dot — malformed.
-            }
-            dot = ptr;
-            ptr++;
-            continue;
-        }
-        if (*ptr < '0' || *ptr > '9') {
-            break;
-        }
+// Reads the reply of R or RT: a reading followed by *OK.
+static int _read_reading(ezoec_t *ec, uint32_t *out_nS) {
+    // The parser already turned the reply into nS, stopping at the first
+    // field of multi-field responses (e.g. "100,54" when TDS is enabled).
+    ezoec_evt_t evt;
+    int result = _next_event(ec, &evt, 2000);
+    if (result == -ETIMEDOUT) {
+        ezoec_session_lost(ec);
+    }
+    if (result < 0) {
+        return result;
+    }
+    if (evt.type != EZOEC_EVT_READING) {
+        DEBUG("[%s]: Not a reading (event %d)\n", __func__, evt.type);
+        return -EINVAL;
+    }
 
-        *out_nS *= 10;
-        *out_nS += (*ptr - 0x30);
-        ptr++;
+    result = ezoec_assert_ok(ec);
+    if (result == -ETIMEDOUT) {
+        ezoec_session_lost(ec);
+    }
+    if (result < 0) {
+        return result;
     }
-    if (ptr == ptr_start) {
-        return -EINVAL; // No digits parsed.
+
+    *out_nS = evt.value;
+    return 0;
+}
+
+int ezoec_measure(ezoec_t *ec, uint32_t *out_nS) {
+    rmutex_lock(&ec->lock);
+    int result = ezoec_writeline(ec, "R");
+    if (result >= 0) {
+        result = _read_reading(ec, out_nS);
     }
+    rmutex_unlock(&ec->lock);
+    return result;
+}
 
-    // Pad missing fractional digits to MAX_DECIMALS.
-    uint8_t decimals = (dot == NULL) ? 0 : (uint8_t)(ptr - dot - 1);
-    for (int x = MAX_DECIMALS - decimals; x > 0; x--) {
-        *out_nS *= 10;
+/**
+ * @brief Reads with temperature compensation, RT sets the compensation
+ * temperature and reads in one command.
+ *
+ * @param centi_C Temperature of the solution in 0.01 C.
+ */
+int ezoec_measure_compensated(ezoec_t *ec, int16_t centi_C, uint32_t *out_nS) {
+    unsigned magnitude = (centi_C < 0) ? -(int32_t)centi_C : centi_C;
+    rmutex_lock(&ec->lock);
+    int result = ezoec_writeline(ec, "RT,%s%u.%02u", (centi_C < 0) ? "-" : "", magnitude / 100, magnitude % 100);
+    if (result >= 0) {
+        result = _read_reading(ec, out_nS);
     }
+    rmutex_unlock(&ec->lock);
+    return result;
+}
 
+/**
+ * @brief Enables or disables continuous mode, in which the EZO sends a reading
+ * about once a second without being asked. Fetch them with ezoec_stream_poll().
+ */
+int ezoec_stream(ezoec_t *ec, int on) {
+    // Streamed readings ahead of the *OK are skipped by ezoec_assert_ok()
+    int result = ezoec_cmd(ec, 0, NULL, 0, "C,%d", on ? 1 : 0);
+    if (result < 0) {
+        return result;
+    }
+    if (on) {
+        ec->session |= EZOEC_SESSION_STREAMING;
+    } else {
+        ec->session &= ~EZOEC_SESSION_STREAMING;
+    }
     return 0;
 }
 
+/**
+ * @brief Takes the next streamed reading out of the receive buffer without
+ * waiting for one.
+ *
+ * @return 1 if @p out_nS was set, 0 if no full reading is buffered or a
+ * command is reading the link.
+ */
+int ezoec_stream_poll(ezoec_t *ec, uint32_t *out_nS) {
+    if (!rmutex_trylock(&ec->lock)) {
+        return 0;
+    }
+
+    int result = 0;
+    ezoec_evt_t evt;
+    int data;
+    while ((data = _rx_get(ec)) >= 0) {
+        if (ezoec_parser_feed(&ec->parser, data, &evt) && evt.type == EZOEC_EVT_READING) {
+            *out_nS = evt.value;
+            result  = 1;
+            break;
+        }
+    }
+
+    rmutex_unlock(&ec->lock);
+    return result;
+}
+
 int ezoec_is_calibrated(ezoec_t *ec) {
     char rx[RX_MAX_LINE_LEN] = {0};
     int result               = ezoec_cmd(ec, 100, rx, sizeof(rx), "Cal,?");
@@ -193,14 +362,64 @@ int ezoec_is_calibrated(ezoec_t *ec) {
     return rx[5] - 0x30;
 }
 
-int ezoec_cal_dry(ezoec_t *ec) { return ezoec_cmd(ec, 0, NULL, 0, "Cal,dry"); }
+// Calibrating changes what the EZO holds, so forget what was imported.
+int ezoec_cal_dry(ezoec_t *ec) {
+    ec->cal_fingerprint = 0;
+    return ezoec_cmd(ec, 0, NULL, 0, "Cal,dry");
+}
+
+int ezoec_cal_low(ezoec_t *ec, uint32_t uS) {
+    ec->cal_fingerprint = 0;
+    return ezoec_cmd(ec, 0, NULL, 0, "Cal,low,%d", uS);
+}
 
-int ezoec_cal_low(ezoec_t *ec, uint32_t uS) { return ezoec_cmd(ec, 0, NULL, 0, "Cal,low,%d", uS); }
+int ezoec_cal_high(ezoec_t *ec, uint32_t uS) {
+    ec->cal_fingerprint = 0;
+    return ezoec_cmd(ec, 0, NULL, 0, "Cal,high,%d", uS);
+}
 
-int ezoec_cal_high(ezoec_t *ec, uint32_t uS) { return ezoec_cmd(ec, 0, NULL, 0, "Cal,high,%d", uS); }
+// FNV-1a over the calibration lines. Never returns 0, which marks "unknown".
+uint32_t ezoec_cal_fingerprint(const ezoec_calibration_t *cal) {
+    const uint8_t *ptr = (const uint8_t *)cal;
+    uint32_t hash      = 2166136261u;
+    for (size_t i = 0; i < sizeof(*cal); i++) {
+        hash ^= ptr[i];
+        hash *= 16777619u;
+    }
+    return hash ? hash : 1;
+}
 
-int ezoec_cal_import(ezoec_t *ec, ezoec_calibration_t *cal) {
+/**
+ * @brief Makes sure the EZO holds the given calibration, importing it only if
+ * it does not already.
+ *
+ * The EZO keeps its calibration over power cycles, so when the last import was
+ * this calibration a "Cal,?" is enough to confirm it is still there.
+ *
+ * @return 0 if the calibration was already loaded, 1 if it was imported,
+ * negative on error.
+ */
+int ezoec_cal_load(ezoec_t *ec, ezoec_calibration_t *cal) {
+    uint32_t fingerprint = ezoec_cal_fingerprint(cal);
+    rmutex_lock(&ec->lock);
+    int result = 0;
+    if (ec->cal_fingerprint == fingerprint && ezoec_is_calibrated(ec) > 0) {
+        DEBUG("[%s]: Calibration %08lx already loaded\n", __func__, (unsigned long)fingerprint);
+    } else {
+        result = ezoec_cal_import(ec, cal);
+        if (result >= 0) {
+            ec->cal_fingerprint = fingerprint;
+            result              = 1;
+        }
+    }
+    rmutex_unlock(&ec->lock);
+    return result;
+}
+
+static int _cal_import(ezoec_t *ec, ezoec_calibration_t *cal) {
     int result = 0;
+    // A partial import leaves the EZO in an unknown state.
+    ec->cal_fingerprint = 0;
     for (int line = 0; line < EZOEC_CALIBRATION_MAX_LINES; line++) {
         result = ezoec_cmd(ec, 0, NULL, 0, "Import,%.12s", cal->line[line]);
         if (result < 0) {
@@ -210,24 +429,23 @@ int ezoec_cal_import(ezoec_t *ec, ezoec_calibration_t *cal) {
     }
 
     // Wait for reset
-    char rxBuffer[13] = {0};
-    result            = ezoec_readline(ec, rxBuffer, 12, 2000);
+    result = _read_status(ec, 2000);
     if (result < 0) {
         DEBUG("[%s]: Error waiting for reset: %d\n", __func__, result);
         return result;
     }
-    if (strcmp(rxBuffer, "*RS") != 0) {
+    if (result != EZOEC_STATUS_RESET) {
         DEBUG("[%s]: Expected EZO reset\n", __func__);
         return 0;
     }
     DEBUG("[%s]: EZO resetting\n", __func__);
 
-    result = ezoec_readline(ec, rxBuffer, 12, 2000);
+    result = _read_status(ec, 2000);
     if (result < 0) {
         DEBUG("[%s]: Error waiting for ready: %d\n", __func__, result);
         return result;
     }
-    if (strcmp(rxBuffer, "*RE") != 0) {
+    if (result != EZOEC_STATUS_READY) {
         DEBUG("[%s]: Expected EZO ready\n", __func__);
         return 0;
     }
@@ -236,122 +454,260 @@ int ezoec_cal_import(ezoec_t *ec, ezoec_calibration_t *cal) {
     return 0;
 }
 
-int ezoec_cal_export(ezoec_t *ec, ezoec_calibration_t *cal) {
-    int result                                       = 0;
-    char rxBuffer[EZOEC_CALIBRATION_LINE_LENGTH + 1] = {0};
+int ezoec_cal_import(ezoec_t *ec, ezoec_calibration_t *cal) {
+    rmutex_lock(&ec->lock);
+    int result = _cal_import(ec, cal);
+    rmutex_unlock(&ec->lock);
+    return result;
+}
+
+static int _cal_export(ezoec_t *ec, ezoec_calibration_t *cal) {
+    int result = 0;
+    ezoec_evt_t evt;
     // Loop one extra iteration to consume the trailing *DONE line.
     for (int line = 0; line < EZOEC_CALIBRATION_MAX_LINES + 1; line++) {
-        result = ezoec_cmd(ec, 1000, rxBuffer, sizeof(rxBuffer), "Export");
+        // Lines are parsed straight into the calibration, bounds-checked
+        // against the fixed-size array.
+        char *dst = (line < EZOEC_CALIBRATION_MAX_LINES) ? cal->line[line] : NULL;
+        ezoec_parser_set_line(&ec->parser, dst, EZOEC_CALIBRATION_LINE_LENGTH);
+
+        result = ezoec_writeline(ec, "Export");
+        if (result >= 0) {
+            result = _next_event(ec, &evt, 1000);
+        }
+        ezoec_parser_set_line(&ec->parser, NULL, 0);
         if (result < 0) {
             DEBUG("[%s]: Error reading export: %d\n", __func__, result);
             return result;
         }
-        if (result > EZOEC_CALIBRATION_LINE_LENGTH) {
-            result = EZOEC_CALIBRATION_LINE_LENGTH;
-        }
-        rxBuffer[result] = 0;
 
-        DEBUG("[%s]: Read %d bytes\n", __func__, result);
-        if (strcmp(rxBuffer, "*DONE") == 0) {
-            DEBUG("[%s]: Done with export\n", __func__);
-            return line;
+        if (evt.type == EZOEC_EVT_STATUS && evt.status != EZOEC_STATUS_DONE) {
+            DEBUG("[%s]: Unexpected status %d\n", __func__, evt.status);
+            return -1;
         }
-
-        // Bounds-check before writing into the fixed-size calibration array.
-        if (line >= EZOEC_CALIBRATION_MAX_LINES) {
+        if (evt.type != EZOEC_EVT_STATUS && dst == NULL) {
             DEBUG("[%s]: Too many export lines, no *DONE seen\n", __func__);
             return -EOVERFLOW;
         }
-        memcpy(cal->line[line], rxBuffer, result);
+        if (dst != NULL) {
+            // *DONE landed in an unused line, clear it as well
+            uint8_t len = (evt.type == EZOEC_EVT_STATUS) ? 0 : evt.len;
+            memset(dst + len, 0, EZOEC_CALIBRATION_LINE_LENGTH - len);
+        }
+
+        result = ezoec_assert_ok(ec);
+        if (result < 0) {
+            return result;
+        }
+
+        DEBUG("[%s]: Read %d bytes\n", __func__, evt.len);
+        if (evt.type == EZOEC_EVT_STATUS) {
+            DEBUG("[%s]: Done with export\n", __func__);
+            return line;
+        }
     }
     return -1;
 }
 
-//
-int ezoec_writeline(ezoec_t *ec, const char *format, ...) {
-    static char txbuf[TX_MAX_LINE_LEN] = {0};
+int ezoec_cal_export(ezoec_t *ec, ezoec_calibration_t *cal) {
+    rmutex_lock(&ec->lock);
+    int result = _cal_export(ec, cal);
+    rmutex_unlock(&ec->lock);
+    return result;
+}
 
-    va_list args;
-    va_start(args, format);
-    int len = vsnprintf(txbuf, sizeof(txbuf) - 1, format, args);
-    va_end(args);
-    if (len < 0 || (size_t)len >= sizeof(txbuf) - 1) {
-        return -EOVERFLOW;
+/**
+ * @brief Fits a correction through the dry, low and high calibration points.
+ *
+ * Readings are raw EZO values taken with the reference calibration loaded,
+ * references are the solution values, all in nS.
+ *
+ * @return 0 on success, -EINVAL if the points are not strictly increasing.
+ */
+int ezoec_correction_fit(ezoec_correction_t *corr, uint32_t dry_nS, uint32_t raw_low_nS, uint32_t ref_low_nS,
+                         uint32_t raw_high_nS, uint32_t ref_high_nS) {
+    if (raw_low_nS <= dry_nS || raw_high_nS <= raw_low_nS || ref_high_nS <= ref_low_nS) {
+        return -EINVAL;
     }
-    txbuf[len++] = '\r';
-    tsrb_clear(&ec->rx_ringbuffer);
-    uart_write(DEV, (uint8_t *)txbuf, len);
 
+    corr->dry_nS        = dry_nS;
+    corr->knee_nS       = raw_low_nS - dry_nS;
+    corr->gain_low_q16  = ((uint64_t)ref_low_nS << 16) / corr->knee_nS;
+    corr->gain_high_q16 = ((uint64_t)(ref_high_nS - ref_low_nS) << 16) / (raw_high_nS - raw_low_nS);
     return 0;
 }
 
-int ezoec_cmd(ezoec_t *ec, uint32_t timeout, char *out, uint8_t out_len, const char *format, ...) {
-    static char txbuf[TX_MAX_LINE_LEN] = {0};
+uint32_t ezoec_correct(const ezoec_correction_t *corr, uint32_t raw_nS) {
+    if (raw_nS <= corr->dry_nS) {
+        return 0;
+    }
 
-    va_list args;
-    va_start(args, format);
+    uint64_t x = raw_nS - corr->dry_nS;
+    uint64_t y;
+    if (x <= corr->knee_nS) {
+        y = (x * corr->gain_low_q16) >> 16;
+    } else {
+        y = (((uint64_t)corr->knee_nS * corr->gain_low_q16) >> 16) +
+            (((x - corr->knee_nS) * corr->gain_high_q16) >> 16);
+    }
+    return y > UINT32_MAX ? UINT32_MAX : (uint32_t)y;
+}
+
+void ezoec_lock(ezoec_t *ec) { rmutex_lock(&ec->lock); }
+
+void ezoec_unlock(ezoec_t *ec) { rmutex_unlock(&ec->lock); }
+
+// Sends one line, dropping what was received before. Caller holds the lock.
+static int _write_line(ezoec_t *ec, const char *format, va_list args) {
+    char txbuf[TX_MAX_LINE_LEN];
     int len = vsnprintf(txbuf, sizeof(txbuf) - 1, format, args);
-    va_end(args);
     if (len < 0 || (size_t)len >= sizeof(txbuf) - 1) {
         return -EOVERFLOW;
     }
     txbuf[len++] = '\r';
 
-    tsrb_clear(&ec->rx_ringbuffer);
-    uart_write(DEV, (uint8_t *)txbuf, len);
+    _rx_reset(ec);
+    EZOEC_UART_WRITE(ec, (uint8_t *)txbuf, len);
 #if ENABLE_DEBUG
     fwrite(txbuf, len, 1, stdout);
     putc('\n', stdout);
 #endif
+    return 0;
+}
+
+int ezoec_writeline(ezoec_t *ec, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    rmutex_lock(&ec->lock);
+    int result = _write_line(ec, format, args);
+    rmutex_unlock(&ec->lock);
+    va_end(args);
+    return result;
+}
+
+static int _cmd(ezoec_t *ec, uint32_t timeout, char *out, uint8_t out_len, const char *format, va_list args) {
+    int result = _write_line(ec, format, args);
+    if (result < 0) {
+        return result;
+    }
 
     // Only if out is given will we read a response
     int rx_len = 0;
     if (out != NULL) {
         rx_len = ezoec_readline(ec, out, out_len, timeout);
+        if (rx_len == -ETIMEDOUT)
+            ezoec_session_lost(ec);
         if (rx_len < 0)
             return rx_len;
     }
 
-    int result = ezoec_assert_ok(ec);
+    result = ezoec_assert_ok(ec);
+    if (result == -ETIMEDOUT)
+        ezoec_session_lost(ec);
     if (result < 0)
         return result;
 
     return rx_len;
 }
 
-int ezoec_readline(ezoec_t *ec, char *buf, uint8_t buf_len, uint32_t timeout) {
-    // Ensure only one readline function can be active at a time.
-    mutex_lock(&ec->readline_lock);
+int ezoec_cmd(ezoec_t *ec, uint32_t timeout, char *out, uint8_t out_len, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    rmutex_lock(&ec->lock);
+    int result = _cmd(ec, timeout, out, out_len, format, args);
+    rmutex_unlock(&ec->lock);
+    va_end(args);
+    return result;
+}
 
-    char *ptr = buf;
+/**
+ * @brief Next received byte, sleeping until a full line, a full buffer or
+ * the deadline timer. Caller holds the lock and armed the timer.
+ */
+static int _rx_pull(ezoec_t *ec, int *timed_out) {
+    for (;;) {
+        int data = _rx_get(ec);
+        if (data >= 0) {
+            return data;
+        }
+        // Buffer drained without a full line. The receive ISR only wakes us
+        // on a line end, a full buffer or (DMA) an idle line, or the
+        // deadline does.
+        if (*timed_out) {
+            return -ETIMEDOUT;
+        }
+        int flags = thread_flags_wait_any(FLAG_RX_DATA | THREAD_FLAG_TIMEOUT);
+        if (flags & THREAD_FLAG_TIMEOUT) {
+            // Still drain what arrived before giving up
+            *timed_out = 1;
+        }
+    }
+}
 
-    int result = 0;
+// Makes the calling thread the reader for one read. Returns the thread that
+// received the wakeups before, _rx_end() hands them back to it.
+static pid_t _rx_begin(ezoec_t *ec, ztimer_t *timer, uint32_t timeout) {
+    // Ensure only one reader can be active at a time.
+    rmutex_lock(&ec->lock);
+    pid_t previous = ec->rx_thread;
+    ec->rx_thread  = thread_getpid();
+
+    // One deadline for the whole read. Drop a timeout flag left over from an
+    // earlier call whose timer fired just before it was removed.
+    thread_flags_clear(THREAD_FLAG_TIMEOUT);
+    ztimer_set_timeout_flag(ZTIMER_MSEC, timer, timeout);
+    return previous;
+}
+
+static void _rx_end(ezoec_t *ec, ztimer_t *timer, pid_t previous) {
+    // Noop if it already fired
+    ztimer_remove(ZTIMER_MSEC, timer);
+    // E.g. a shell command while the async worker streams: the worker gets the
+    // link back, and a wakeup for what arrived after this read's last line.
+    ec->rx_thread = previous;
+    if (previous != thread_getpid() && !_rx_empty(ec)) {
+        thread_flags_set(thread_get(previous), FLAG_RX_DATA);
+    }
+    rmutex_unlock(&ec->lock);
+}
+
+/**
+ * @brief Parses received bytes until the next event (a non-empty line).
+ */
+static int _next_event(ezoec_t *ec, ezoec_evt_t *evt, uint32_t timeout) {
     ztimer_t timer;
-    ec->rx_thread = thread_getpid();
+    int timed_out = 0;
+    int result    = 0;
+    pid_t reader  = _rx_begin(ec, &timer, timeout);
 
     for (;;) {
-        // If there is no uart data in the buffer, we'll wait for some to
-        // appear, or timeout.
-        if (tsrb_avail(&ec->rx_ringbuffer) == 0) {
-            ztimer_set_timeout_flag(ZTIMER_MSEC, &timer, timeout);
-
-            // Wait for flag and clear it. Returns the flags that were set.
-            int flags = thread_flags_wait_any(FLAG_RX_DATA | THREAD_FLAG_TIMEOUT);
-
-            // Make sure to remove the timer if it didn't fire already. Noop if
-            // it did.
-            ztimer_remove(ZTIMER_MSEC, &timer);
-
-            // If there is no RX_DATA flag set, but it has timed out, we exit.
-            if ((flags & FLAG_RX_DATA) == 0 && (flags & THREAD_FLAG_TIMEOUT) > 0) {
-                result = -ETIMEDOUT;
-                break;
-            }
+        int data = _rx_pull(ec, &timed_out);
+        if (data < 0) {
+            result = data;
+            break;
+        }
+        if (ezoec_parser_feed(&ec->parser, data, evt)) {
+            break;
         }
+    }
+
+    _rx_end(ec, &timer, reader);
+    return result;
+}
+
+int ezoec_readline(ezoec_t *ec, char *buf, uint8_t buf_len, uint32_t timeout) {
+    char *ptr = buf;
+
+    ztimer_t timer;
+    int timed_out = 0;
+    int result    = 0;
+    pid_t reader  = _rx_begin(ec, &timer, timeout);
 
-        int data = tsrb_get_one(&ec->rx_ringbuffer);
+    for (;;) {
+        int data = _rx_pull(ec, &timed_out);
         if (data < 0) {
-            continue;
+            result = data;
+            break;
         }
 
         if (data == '\r') {
@@ -361,6 +717,8 @@ int ezoec_readline(ezoec_t *ec, char *buf, uint8_t buf_len, uint32_t timeout) {
             fwrite(buf, result, 1, stdout);
             putc('\n', stdout);
 #endif
+            // Raw lines bypass the parser, it starts over on the next line
+            ezoec_parser_reset(&ec->parser);
             break;
         }
 
@@ -371,7 +729,7 @@ int ezoec_readline(ezoec_t *ec, char *buf, uint8_t buf_len, uint32_t timeout) {
         }
     }
 
-    mutex_unlock(&ec->readline_lock);
+    _rx_end(ec, &timer, reader);
     return result;
 }
 
@@ -385,16 +743,19 @@ read_status:
     }
     DEBUG("[%s]: Status: %d\n", __func__, result);
     switch (result) {
-    case STATUS_OK:
+    case EZOEC_STATUS_OK:
         return 0;
-    case STATUS_ERROR:
+    case EZOEC_STATUS_ERROR:
         return -1;
-    case STATUS_OVERVOLT:
-    case STATUS_UNDERVOLT:
-    case STATUS_RESET:
-    case STATUS_READY:
-    case STATUS_SLEEP:
-    case STATUS_WAKE:
+    case EZOEC_STATUS_RESET:
+        // Expected resets (import, factory) consume *RS themselves.
+        ezoec_session_lost(ec);
+        goto read_status;
+    case EZOEC_STATUS_OVERVOLT:
+    case EZOEC_STATUS_UNDERVOLT:
+    case EZOEC_STATUS_READY:
+    case EZOEC_STATUS_SLEEP:
+    case EZOEC_STATUS_WAKE:
         goto read_status;
     default:
         return -2;
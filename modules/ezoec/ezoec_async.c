@@ -0,0 +1,199 @@
+/*
+ * Asynchronous EZO command queue.
+ *
+ * The worker thread runs queued requests with the blocking ezoec_* calls, so
+ * the response handling is the one of the synchronous API. Receive wakeups go
+ * to the worker as it is the reader (see _rx_begin()), the submitter only
+ * hears back through the completion callback or msg.
+ */
+#include "ezoec_async.h"
+#include "irq.h"
+#include "msg.h"
+#include "thread.h"
+#include "thread_flags.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <sys/errno.h>
+
+#define ENABLE_DEBUG 0
+#include "debug.h"
+
+#define FLAG_RX_DATA (1u << 0) // Set by the receive ISR, see ezoec.c
+#define FLAG_QUEUED  (1u << 1)
+
+static char worker_stack[EZOEC_ASYNC_STACKSIZE];
+static kernel_pid_t worker_pid = KERNEL_PID_UNDEF;
+static ezoec_t *worker_ec      = NULL;
+
+// Requests in submission order, the head is the one running
+static ezoec_req_t *queue_head = NULL;
+static ezoec_req_t *queue_tail = NULL;
+static unsigned queue_len      = 0;
+
+// Where streamed readings go, see ezoec_async_stream()
+static kernel_pid_t stream_target = KERNEL_PID_UNDEF;
+static uint16_t stream_msg_type;
+
+static int _op_cmd(ezoec_t *ec, ezoec_req_t *req) {
+    return ezoec_cmd(ec, req->timeout, req->out, req->out_len, "%s", req->cmd);
+}
+
+static int _op_measure(ezoec_t *ec, ezoec_req_t *req) { return ezoec_measure(ec, &req->value); }
+
+static void _complete(ezoec_req_t *req, int result) {
+    unsigned state = irq_disable();
+    queue_head     = req->next;
+    if (queue_head == NULL) {
+        queue_tail = NULL;
+    }
+    queue_len--;
+    req->next = NULL;
+    irq_restore(state);
+
+    // The submitter may reuse the request from here on
+    req->result = result;
+    if (req->cb != NULL) {
+        req->cb(req);
+    } else if (req->target != KERNEL_PID_UNDEF) {
+        // Never block the worker on a full queue, req->result tells anyway
+        msg_t msg = {.type = req->msg_type, .content.ptr = req};
+        if (msg_try_send(&msg, req->target) != 1) {
+            DEBUG("[ezoec_async]: Completion msg dropped\n");
+        }
+    }
+}
+
+// Forwards the readings buffered since the last wakeup. Readings that arrive
+// while a request runs are consumed by it.
+static void _stream_forward(void) {
+    uint32_t nS;
+    while (ezoec_stream_poll(worker_ec, &nS) > 0) {
+        kernel_pid_t target = stream_target;
+        if (target == KERNEL_PID_UNDEF || !(worker_ec->session & EZOEC_SESSION_STREAMING)) {
+            continue;
+        }
+        msg_t msg = {.type = stream_msg_type, .content.value = nS};
+        if (msg_try_send(&msg, target) != 1) {
+            DEBUG("[ezoec_async]: Streamed reading dropped\n");
+        }
+    }
+}
+
+static void *_worker(void *arg) {
+    (void)arg;
+    for (;;) {
+        thread_flags_t flags = thread_flags_wait_any(FLAG_QUEUED | FLAG_RX_DATA);
+        if (flags & FLAG_RX_DATA) {
+            _stream_forward();
+        }
+
+        ezoec_req_t *req;
+        while ((req = queue_head) != NULL) {
+            DEBUG("[ezoec_async]: Run %s\n", req->op == _op_cmd ? req->cmd : "op");
+            _complete(req, req->op(worker_ec, req));
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Starts the worker for @p ec. There is one worker, for one EZO.
+ */
+int ezoec_async_init(ezoec_t *ec) {
+    if (worker_pid != KERNEL_PID_UNDEF) {
+        return (worker_ec == ec) ? 0 : -EBUSY;
+    }
+
+    worker_ec  = ec;
+    worker_pid = thread_create(worker_stack, sizeof(worker_stack), EZOEC_ASYNC_PRIO, THREAD_CREATE_STACKTEST,
+                               _worker, NULL, "ezoec");
+    if (worker_pid < 0) {
+        worker_pid = KERNEL_PID_UNDEF;
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+/**
+ * @brief Queues a request with its op already set. Safe from interrupts.
+ *
+ * @return 0 when queued, -EBUSY if the request is still queued.
+ */
+int ezoec_async_submit(ezoec_t *ec, ezoec_req_t *req) {
+    if (ec != worker_ec || worker_pid == KERNEL_PID_UNDEF || req->op == NULL) {
+        return -ENODEV;
+    }
+
+    unsigned state = irq_disable();
+    if (req->result == -EINPROGRESS) {
+        irq_restore(state);
+        return -EBUSY;
+    }
+    req->result = -EINPROGRESS;
+    req->next   = NULL;
+    if (queue_tail != NULL) {
+        queue_tail->next = req;
+    } else {
+        queue_head = req;
+    }
+    queue_tail = req;
+    queue_len++;
+    irq_restore(state);
+
+    thread_flags_set(thread_get(worker_pid), FLAG_QUEUED);
+    return 0;
+}
+
+/**
+ * @brief Queues a command, ezoec_cmd() style. The response line (if req->out
+ * is set) is read with req->timeout.
+ */
+int ezoec_async_cmd(ezoec_t *ec, ezoec_req_t *req, const char *format, ...) {
+    if (req->result == -EINPROGRESS) {
+        return -EBUSY;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(req->cmd, sizeof(req->cmd), format, args);
+    va_end(args);
+    if (len < 0 || (size_t)len >= sizeof(req->cmd)) {
+        return -EOVERFLOW;
+    }
+
+    req->op = _op_cmd;
+    return ezoec_async_submit(ec, req);
+}
+
+/**
+ * @brief Queues a reading, the result lands in req->value (nS).
+ */
+int ezoec_async_measure(ezoec_t *ec, ezoec_req_t *req) {
+    if (req->result == -EINPROGRESS) {
+        return -EBUSY;
+    }
+    req->op = _op_measure;
+    return ezoec_async_submit(ec, req);
+}
+
+/**
+ * @brief Number of requests queued or running.
+ */
+int ezoec_async_pending(const ezoec_t *ec) { return (ec == worker_ec) ? (int)queue_len : 0; }
+
+/**
+ * @brief Has the worker forward readings of continuous mode (ezoec_stream())
+ * as msgs with content.value in nS. Pass KERNEL_PID_UNDEF to stop.
+ *
+ * The worker becomes the reader of the link, so the receive wakeups reach it
+ * while it is idle.
+ */
+int ezoec_async_stream(ezoec_t *ec, kernel_pid_t target, uint16_t msg_type) {
+    if (ec != worker_ec || worker_pid == KERNEL_PID_UNDEF) {
+        return -ENODEV;
+    }
+    stream_msg_type = msg_type;
+    stream_target   = target;
+    ec->rx_thread   = worker_pid;
+    return 0;
+}
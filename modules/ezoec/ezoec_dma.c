@@ -0,0 +1,88 @@
+/*
+ * DMA receive path for the EZO link (pseudomodule ezoec_dma).
+ *
+ * RIOT's uart_init() still configures clocks, baud rate and TX. Without an rx
+ * callback it leaves the receiver off, which is then enabled here with DMA
+ * requests and the idle-line interrupt. The board must not let the RIOT UART
+ * driver claim the LPUART1 vector (see UART_1_ISR in periph_conf.h).
+ *
+ * LPUART1_RX is DMA1 channel 3, request 5 (RM0451, table 41).
+ */
+#include "ezoec.h"
+#include "kernel_defines.h"
+
+#if IS_USED(MODULE_EZOEC_DMA)
+#include "cpu.h"
+#include "ezoec_dma.h"
+#include "periph/cpu_gpio.h"
+#include "periph/gpio.h"
+#include "periph/uart.h"
+#include "periph_conf.h"
+#include "thread.h"
+#include "thread_flags.h"
+#include <sys/errno.h>
+
+#define ENABLE_DEBUG 0
+#include "debug.h"
+
+#define EZOEC_DMA_CHANNEL  DMA1_Channel3
+#define EZOEC_DMA_REQUEST  (5U << DMA_CSELR_C3S_Pos)
+#define EZOEC_DMA_RX_FLAG  (1u << 0) // Same flag ezoec_readline() waits on
+
+static ezoec_t *dma_ec = NULL;
+
+int ezoec_dma_init(ezoec_t *ec) {
+    uart_t dev = UART_DEV(ec->params.uart);
+    if (uart_config[dev].dev != LPUART1) {
+        return -ENODEV;
+    }
+
+    int result = uart_init(dev, ec->params.baud_rate, NULL, NULL);
+    if (result < 0) {
+        return result;
+    }
+    USART_TypeDef *uart = uart_config[dev].dev;
+
+    gpio_init(uart_config[dev].rx_pin, GPIO_IN);
+    gpio_init_af(uart_config[dev].rx_pin, uart_config[dev].rx_af);
+
+    RCC->AHBENR |= RCC_AHBENR_DMAEN;
+    EZOEC_DMA_CHANNEL->CCR = 0;
+    DMA1_CSELR->CSELR      = (DMA1_CSELR->CSELR & ~DMA_CSELR_C3S) | EZOEC_DMA_REQUEST;
+    EZOEC_DMA_CHANNEL->CPAR  = (uint32_t)&uart->RDR;
+    EZOEC_DMA_CHANNEL->CMAR  = (uint32_t)ec->rx_buffer;
+    EZOEC_DMA_CHANNEL->CNDTR = sizeof(ec->rx_buffer);
+    // Peripheral to memory, bytes, memory increment, wrap around
+    EZOEC_DMA_CHANNEL->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_EN;
+
+    dma_ec      = ec;
+    ec->rx_tail = 0;
+
+    uart->ICR = USART_ICR_IDLECF | USART_ICR_ORECF;
+    uart->CR3 |= USART_CR3_DMAR;
+    uart->CR1 |= USART_CR1_RE | USART_CR1_IDLEIE;
+    NVIC_EnableIRQ(uart_config[dev].irqn);
+
+    DEBUG("[%s]: DMA receive at %u\n", __func__, ec->params.baud_rate);
+    return 0;
+}
+
+uint16_t ezoec_dma_head(const ezoec_t *ec) { return sizeof(ec->rx_buffer) - EZOEC_DMA_CHANNEL->CNDTR; }
+
+void isr_lpuart1(void) {
+    uint32_t status = LPUART1->ISR;
+
+    if (status & USART_ISR_ORE) {
+        LPUART1->ICR = USART_ICR_ORECF;
+    }
+    // The line went quiet after a burst: a response (or part of one) is in.
+    if (status & USART_ISR_IDLE) {
+        LPUART1->ICR = USART_ICR_IDLECF;
+        if (dma_ec != NULL) {
+            thread_flags_set(thread_get(dma_ec->rx_thread), EZOEC_DMA_RX_FLAG);
+        }
+    }
+
+    cortexm_isr_end();
+}
+#endif
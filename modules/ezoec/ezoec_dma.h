@@ -0,0 +1,28 @@
+#ifndef EZOEC_DMA_H
+#define EZOEC_DMA_H
+
+#include "ezoec.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Receives LPUART1 by circular DMA straight into ec->rx_buffer.
+ *
+ * The LPUART idle-line interrupt wakes the reader once a response burst has
+ * ended, there is no per byte interrupt.
+ */
+int ezoec_dma_init(ezoec_t *ec);
+
+/**
+ * @brief Index in ec->rx_buffer the DMA writes next.
+ */
+uint16_t ezoec_dma_head(const ezoec_t *ec);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* end of include guard: EZOEC_DMA_H */
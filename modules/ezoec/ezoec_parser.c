@@ -0,0 +1,123 @@
+#include "ezoec_parser.h"
+#include <stddef.h>
+#include <string.h>
+
+void ezoec_parser_reset(ezoec_parser_t *p) {
+    p->len = 0;
+}
+
+/**
+ * @brief Has the raw text of following lines copied into @p line, NULL to
+ * drop it. Applies from the next line end on.
+ */
+void ezoec_parser_set_line(ezoec_parser_t *p, char *line, uint8_t cap) {
+    p->line     = line;
+    p->line_cap = (line == NULL) ? 0 : cap;
+}
+
+static ezoec_status_t _status(const char *status) {
+    if (strcmp(status, "*OK") == 0)
+        return EZOEC_STATUS_OK;
+    if (strcmp(status, "*ER") == 0)
+        return EZOEC_STATUS_ERROR;
+    if (strcmp(status, "*OV") == 0)
+        return EZOEC_STATUS_OVERVOLT;
+    if (strcmp(status, "*UV") == 0)
+        return EZOEC_STATUS_UNDERVOLT;
+    if (strcmp(status, "*RS") == 0)
+        return EZOEC_STATUS_RESET;
+    if (strcmp(status, "*RE") == 0)
+        return EZOEC_STATUS_READY;
+    if (strcmp(status, "*SL") == 0)
+        return EZOEC_STATUS_SLEEP;
+    if (strcmp(status, "*WA") == 0)
+        return EZOEC_STATUS_WAKE;
+    if (strcmp(status, "*DONE") == 0)
+        return EZOEC_STATUS_DONE;
+    return EZOEC_STATUS_UNKNOWN;
+}
+
+/**
+ * @brief Scans the first field of @p rx as a reading in nS. Digits beyond
+ * EZOEC_PARSER_DECIMALS are truncated.
+ *
+ * @return 0 on success, -1 if it is not a number or does not fit 32 bits
+ */
+static int _measure(const char *rx, uint8_t rx_len, uint32_t *out_nS) {
+    const char *ptr_start = rx;
+    const char *ptr_end   = ptr_start + rx_len;
+    const char *ptr       = ptr_start;
+    const char *dot       = NULL;
+    uint8_t decimals      = 0;
+    uint32_t value        = 0;
+
+    while (ptr < ptr_end) {
+        if (*ptr == '.') {
+            if (dot != NULL) {
+                return -1;
+            }
+            dot = ptr++;
+            continue;
+        }
+        if (*ptr < '0' || *ptr > '9') {
+            break;
+        }
+        if (dot == NULL || decimals < EZOEC_PARSER_DECIMALS) {
+            // A long or garbled number must not wrap into a plausible reading
+            if (value > (UINT32_MAX - 9) / 10) {
+                return -1;
+            }
+            value = value * 10 + (*ptr - '0');
+            decimals += (dot != NULL);
+        }
+        ptr++;
+    }
+    if (ptr == ptr_start) {
+        return -1;
+    }
+    // A reading is a number up to the end of the line or the first field
+    if (ptr != ptr_end && *ptr != ',') {
+        return -1;
+    }
+    for (; decimals < EZOEC_PARSER_DECIMALS; decimals++) {
+        if (value > UINT32_MAX / 10) {
+            return -1;
+        }
+        value *= 10;
+    }
+    *out_nS = value;
+    return 0;
+}
+
+/**
+ * @brief Finishes the current line, see ezoec_parser_feed().
+ *
+ * @return 1 if @p evt was filled, 0 for an empty line.
+ */
+int ezoec_parser_end_line(ezoec_parser_t *p, ezoec_evt_t *evt) {
+    uint8_t len = p->len;
+    if (len == 0) {
+        return 0;
+    }
+    p->len = 0;
+
+    uint8_t stored = (len < EZOEC_PARSER_LINE_MAX) ? len : EZOEC_PARSER_LINE_MAX;
+    p->buf[stored] = 0;
+
+    uint8_t cap    = (p->line == NULL) ? UINT8_MAX : p->line_cap;
+    evt->len       = (len < cap) ? len : cap;
+    evt->truncated = (len > cap);
+    if (p->line != NULL) {
+        memcpy(p->line, p->buf, (stored < cap) ? stored : cap);
+    }
+
+    if (p->buf[0] == '*') {
+        evt->type   = EZOEC_EVT_STATUS;
+        evt->status = (len > stored) ? EZOEC_STATUS_UNKNOWN : _status(p->buf);
+    } else if (len == stored && _measure(p->buf, stored, &evt->value) == 0) {
+        evt->type = EZOEC_EVT_READING;
+    } else {
+        evt->type = EZOEC_EVT_LINE;
+    }
+    return 1;
+}
@@ -0,0 +1,59 @@
+/*
+ * Temperature compensation of conductivity readings in firmware, integer only.
+ *
+ * ezoec_tc_lut.h is generated by gen_tc_lut.py from the cubic fits of the
+ * reference solutions (see calibration.py) and holds, per degree, the factor
+ * that takes a reading at that temperature back to 25 C, for the low and the
+ * high solution.
+ */
+#include "ezoec_tc.h"
+#include "ezoec_tc_lut.h"
+
+#define LUT_MAX_CC (EZOEC_TC_LUT_MIN_CC + (EZOEC_TC_LUT_LEN - 1) * EZOEC_TC_LUT_STEP_CC)
+
+/**
+ * @brief Normalises a reading taken at @p centi_C to 25 C.
+ *
+ * Both reference curves are interpolated linearly between the table steps and
+ * then blended by where the reading lies between the two solutions at 25 C.
+ * Outside of the table the temperature is clamped, outside of the solutions
+ * the nearer curve is used alone.
+ */
+uint32_t ezoec_tc_normalise(uint32_t nS, int16_t centi_C) {
+    int32_t t = centi_C;
+    if (t < EZOEC_TC_LUT_MIN_CC) {
+        t = EZOEC_TC_LUT_MIN_CC;
+    } else if (t > LUT_MAX_CC) {
+        t = LUT_MAX_CC;
+    }
+
+    t -= EZOEC_TC_LUT_MIN_CC;
+    uint32_t i   = t / EZOEC_TC_LUT_STEP_CC;
+    int32_t frac = t % EZOEC_TC_LUT_STEP_CC;
+    if (i == EZOEC_TC_LUT_LEN - 1) {
+        i--;
+        frac = EZOEC_TC_LUT_STEP_CC;
+    }
+
+    const uint16_t *a = ezoec_tc_lut[i];
+    const uint16_t *b = ezoec_tc_lut[i + 1];
+    int32_t low       = a[0] + ((int32_t)b[0] - a[0]) * frac / EZOEC_TC_LUT_STEP_CC;
+    int32_t high      = a[1] + ((int32_t)b[1] - a[1]) * frac / EZOEC_TC_LUT_STEP_CC;
+
+    // The curves belong to the 25 C conductivity of the solutions, so the
+    // blend weight of the high curve (Q16) is taken from a first estimate of
+    // it, using the mean of both factors.
+    uint64_t estimate = ((uint64_t)nS * (uint32_t)(low + high)) >> (EZOEC_TC_LUT_SHIFT + 1);
+    int32_t weight;
+    if (estimate <= EZOEC_TC_REF_LOW_NS) {
+        weight = 0;
+    } else if (estimate >= EZOEC_TC_REF_HIGH_NS) {
+        weight = 1 << 16;
+    } else {
+        weight = ((estimate - EZOEC_TC_REF_LOW_NS) << 16) / (EZOEC_TC_REF_HIGH_NS - EZOEC_TC_REF_LOW_NS);
+    }
+    uint32_t factor = low + (((high - low) * weight) >> 16);
+
+    uint64_t y = ((uint64_t)nS * factor + (1u << (EZOEC_TC_LUT_SHIFT - 1))) >> EZOEC_TC_LUT_SHIFT;
+    return y > UINT32_MAX ? UINT32_MAX : (uint32_t)y;
+}
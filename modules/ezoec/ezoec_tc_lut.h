@@ -0,0 +1,69 @@
+// Generated by gen_tc_lut.py from the reference solutions in calibration.py, do not edit.
+#ifndef EZOEC_TC_LUT_H
+#define EZOEC_TC_LUT_H
+
+#include <stdint.h>
+
+#define EZOEC_TC_LUT_MIN_CC  0
+#define EZOEC_TC_LUT_STEP_CC 100
+#define EZOEC_TC_LUT_LEN     51
+#define EZOEC_TC_LUT_SHIFT   14
+#define EZOEC_TC_REF_LOW_NS  12880000UL
+#define EZOEC_TC_REF_HIGH_NS 80000000UL
+
+// Reading at 25 C / reading at T, for the low and the high reference
+static const uint16_t ezoec_tc_lut[EZOEC_TC_LUT_LEN][2] = {
+    {29204, 26713}, //  0 C
+    {28443, 26273}, //  1 C
+    {27710, 25825}, //  2 C
+    {27002, 25372}, //  3 C
+    {26319, 24914}, //  4 C
+    {25660, 24455}, //  5 C
+    {25024, 23995}, //  6 C
+    {24411, 23536}, //  7 C
+    {23819, 23079}, //  8 C
+    {23249, 22626}, //  9 C
+    {22698, 22178}, // 10 C
+    {22166, 21735}, // 11 C
+    {21653, 21298}, // 12 C
+    {21158, 20868}, // 13 C
+    {20681, 20446}, // 14 C
+    {20219, 20032}, // 15 C
+    {19774, 19626}, // 16 C
+    {19344, 19229}, // 17 C
+    {18928, 18841}, // 18 C
+    {18527, 18462}, // 19 C
+    {18139, 18092}, // 20 C
+    {17764, 17732}, // 21 C
+    {17401, 17381}, // 22 C
+    {17051, 17039}, // 23 C
+    {16712, 16707}, // 24 C
+    {16384, 16384}, // 25 C
+    {16067, 16070}, // 26 C
+    {15760, 15765}, // 27 C
+    {15463, 15469}, // 28 C
+    {15175, 15182}, // 29 C
+    {14897, 14903}, // 30 C
+    {14627, 14633}, // 31 C
+    {14366, 14371}, // 32 C
+    {14113, 14117}, // 33 C
+    {13868, 13871}, // 34 C
+    {13630, 13633}, // 35 C
+    {13400, 13402}, // 36 C
+    {13176, 13178}, // 37 C
+    {12959, 12961}, // 38 C
+    {12749, 12752}, // 39 C
+    {12545, 12549}, // 40 C
+    {12347, 12352}, // 41 C
+    {12155, 12162}, // 42 C
+    {11969, 11978}, // 43 C
+    {11788, 11801}, // 44 C
+    {11612, 11629}, // 45 C
+    {11441, 11462}, // 46 C
+    {11275, 11302}, // 47 C
+    {11114, 11146}, // 48 C
+    {10958, 10996}, // 49 C
+    {10805, 10851}, // 50 C
+};
+
+#endif /* end of include guard: EZOEC_TC_LUT_H */
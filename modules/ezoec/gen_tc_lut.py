@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""Generates ezoec_tc_lut.h, the temperature compensation table.
+
+Fits the same cubic polynomials as calibration.py through the reference
+solution tables and stores, per temperature step, the factor that takes a
+reading of each solution back to its 25 C value, in fixed point. Standard
+library only so the firmware build does not depend on numpy.
+
+With --fixture it writes tests/tc_ref_solutions.h instead, the same tables
+for tests/test_tc_lut.c to check the firmware against.
+
+Usage: gen_tc_lut.py [--fixture] [output]   (stdout when no output is given)
+"""
+import os
+import sys
+
+# Reference solutions (uS/cm) over temperature (C), kept in calibration.py
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", ".."))
+from calibration import c_high, c_low, t_high, t_low  # noqa: E402
+
+T_MIN_C = 0
+T_MAX_C = 50
+T_STEP_C = 1
+SHIFT = 14  # Factors are Q2.14, the largest (0 C) is below 2
+
+
+def polyfit(xs, ys, order):
+    """Least squares polynomial fit, coefficients lowest order first."""
+    n = order + 1
+    # Normal equations A c = b
+    a = [[sum(x ** (i + j) for x in xs) for j in range(n)] for i in range(n)]
+    b = [sum(y * x ** i for x, y in zip(xs, ys)) for i in range(n)]
+    for col in range(n):
+        pivot = max(range(col, n), key=lambda r: abs(a[r][col]))
+        a[col], a[pivot] = a[pivot], a[col]
+        b[col], b[pivot] = b[pivot], b[col]
+        for row in range(col + 1, n):
+            f = a[row][col] / a[col][col]
+            for k in range(col, n):
+                a[row][k] -= f * a[col][k]
+            b[row] -= f * b[col]
+    c = [0.0] * n
+    for row in reversed(range(n)):
+        c[row] = (b[row] - sum(a[row][k] * c[k] for k in range(row + 1, n))) / a[row][row]
+    return c
+
+
+def polyval(c, x):
+    return sum(coef * x ** i for i, coef in enumerate(c))
+
+
+def factors(t_ref, c_ref):
+    fit = polyfit(t_ref, c_ref, 3)
+    at_25 = polyval(fit, 25)
+    out = []
+    for t in range(T_MIN_C, T_MAX_C + 1, T_STEP_C):
+        value = round(at_25 / polyval(fit, t) * (1 << SHIFT))
+        if not 0 < value <= 0xFFFF:
+            raise ValueError(f"factor at {t} C does not fit Q{16 - SHIFT}.{SHIFT}")
+        out.append(value)
+    return out
+
+
+def render():
+    low = factors(t_low, c_low)
+    high = factors(t_high, c_high)
+    lines = [
+        "// Generated by gen_tc_lut.py from the reference solutions in calibration.py, do not edit.",
+        "#ifndef EZOEC_TC_LUT_H",
+        "#define EZOEC_TC_LUT_H",
+        "",
+        "#include <stdint.h>",
+        "",
+        f"#define EZOEC_TC_LUT_MIN_CC  {T_MIN_C * 100}",
+        f"#define EZOEC_TC_LUT_STEP_CC {T_STEP_C * 100}",
+        f"#define EZOEC_TC_LUT_LEN     {len(low)}",
+        f"#define EZOEC_TC_LUT_SHIFT   {SHIFT}",
+        f"#define EZOEC_TC_REF_LOW_NS  {c_low[t_low.index(25)] * 1000}UL",
+        f"#define EZOEC_TC_REF_HIGH_NS {c_high[t_high.index(25)] * 1000}UL",
+        "",
+        "// Reading at 25 C / reading at T, for the low and the high reference",
+        "static const uint16_t ezoec_tc_lut[EZOEC_TC_LUT_LEN][2] = {",
+    ]
+    for i, (lo, hi) in enumerate(zip(low, high)):
+        lines.append(f"    {{{lo:5d}, {hi:5d}}}, // {T_MIN_C + i * T_STEP_C:2d} C")
+    lines += ["};", "", "#endif /* end of include guard: EZOEC_TC_LUT_H */", ""]
+    return "\n".join(lines)
+
+
+def render_fixture():
+    def array(ctype, name, values):
+        return f"static const {ctype} {name}[] = {{{', '.join(str(v) for v in values)}}};"
+
+    lines = [
+        "// Generated by modules/ezoec/gen_tc_lut.py --fixture from calibration.py, do not edit.",
+        "#ifndef TC_REF_SOLUTIONS_H",
+        "#define TC_REF_SOLUTIONS_H",
+        "",
+        "#include <stdint.h>",
+        "",
+        "// Reference solutions (uS/cm) over temperature (C)",
+        array("int16_t", "t_low", t_low),
+        array("uint32_t", "c_low", c_low),
+        array("int16_t", "t_high", t_high),
+        array("uint32_t", "c_high", c_high),
+        "",
+        f"#define C_LOW_AT_25  {c_low[t_low.index(25)]}",
+        f"#define C_HIGH_AT_25 {c_high[t_high.index(25)]}",
+        "",
+        "#endif /* end of include guard: TC_REF_SOLUTIONS_H */",
+        "",
+    ]
+    return "\n".join(lines)
+
+
+def main():
+    args = sys.argv[1:]
+    if args[:1] == ["--fixture"]:
+        text = render_fixture()
+        args = args[1:]
+    else:
+        text = render()
+    if args:
+        with open(args[0], "w") as file:
+            file.write(text)
+    else:
+        sys.stdout.write(text)
+
+
+if __name__ == "__main__":
+    main()
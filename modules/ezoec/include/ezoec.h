@@ -1,7 +1,8 @@
 #ifndef EZOEC_H
 #define EZOEC_H
 
-#include "mutex.h"
+#include "ezoec_parser.h"
+#include "rmutex.h"
 #include "tsrb.h"
 #include <stdint.h>
 #include <sys/types.h>
@@ -11,6 +12,11 @@
 #define EZOEC_CALIBRATION_LINE_LENGTH 12
 #define EZOEC_CALIBRATION_MAX_LINES   10
 
+// ezoec_t session flags
+#define EZOEC_SESSION_OPEN      (1 << 0) // UART is set up
+#define EZOEC_SESSION_ALIVE     (1 << 1) // Handshake done and no reset or timeout seen since
+#define EZOEC_SESSION_STREAMING (1 << 2) // Continuous mode (C,1) enabled by us
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -24,16 +30,36 @@ typedef struct {
     ezoec_params_t params;
     uint8_t rx_buffer[RX_BUFFER_SIZE];
     tsrb_t rx_ringbuffer;
+    uint16_t rx_tail; // Read index into rx_buffer when receiving by DMA
     pid_t rx_thread;
-    mutex_t readline_lock;
+    rmutex_t lock; // One command or read sequence at a time, recursive
+    ezoec_parser_t parser;
+    uint32_t cal_fingerprint; // Fingerprint of the calibration last imported, 0 if unknown
+    uint8_t session;          // EZOEC_SESSION_* flags
 } ezoec_t;
 
 typedef struct {
     char line[EZOEC_CALIBRATION_MAX_LINES][EZOEC_CALIBRATION_LINE_LENGTH];
 } ezoec_calibration_t;
 
+// Firmware side two-segment linear correction of raw EZO readings, used when
+// the EZO keeps a single reference calibration for all probes.
+typedef struct {
+    uint32_t dry_nS;        // Raw reading of the dry probe, subtracted first
+    uint32_t knee_nS;       // Raw reading above dry at the low point, where the segments meet
+    uint32_t gain_low_q16;  // Gain below the knee, Q16.16
+    uint32_t gain_high_q16; // Gain above the knee, Q16.16
+} ezoec_correction_t;
+
 int ezoec_init(ezoec_t *ec, const ezoec_params_t *params);
+int ezoec_open(ezoec_t *ec, const ezoec_params_t *params);
+int ezoec_resume(ezoec_t *ec, const ezoec_params_t *params);
+void ezoec_session_lost(ezoec_t *ec);
+int ezoec_wait_ready(ezoec_t *ec, uint32_t timeout);
 int ezoec_measure(ezoec_t *ec, uint32_t *out_nS);
+int ezoec_measure_compensated(ezoec_t *ec, int16_t centi_C, uint32_t *out_nS);
+int ezoec_stream(ezoec_t *ec, int on);
+int ezoec_stream_poll(ezoec_t *ec, uint32_t *out_nS);
 int ezoec_set_baud(ezoec_t *ec, unsigned int baud);
 int ezoec_factory(ezoec_t *ec);
 int ezoec_set_k(ezoec_t *ec, uint8_t k_value);
@@ -43,8 +69,16 @@ int ezoec_cal_low(ezoec_t *ec, uint32_t uS);
 int ezoec_cal_high(ezoec_t *ec, uint32_t uS);
 int ezoec_cal_import(ezoec_t *ec, ezoec_calibration_t *cal);
 int ezoec_cal_export(ezoec_t *ec, ezoec_calibration_t *cal);
+uint32_t ezoec_cal_fingerprint(const ezoec_calibration_t *cal);
+int ezoec_cal_load(ezoec_t *ec, ezoec_calibration_t *cal);
+int ezoec_correction_fit(ezoec_correction_t *corr, uint32_t dry_nS, uint32_t raw_low_nS, uint32_t ref_low_nS,
+                         uint32_t raw_high_nS, uint32_t ref_high_nS);
+uint32_t ezoec_correct(const ezoec_correction_t *corr, uint32_t raw_nS);
 
-// Exposed private functions for "powerusers"
+// Exposed private functions for "powerusers". Hold ezoec_lock() around a
+// writeline/readline sequence when another thread may use the link.
+void ezoec_lock(ezoec_t *ec);
+void ezoec_unlock(ezoec_t *ec);
 int ezoec_writeline(ezoec_t *ec, const char *format, ...);
 int ezoec_readline(ezoec_t *ec, char *buf, uint8_t buf_len, uint32_t timeout);
 int ezoec_assert_ok(ezoec_t *ec);
@@ -0,0 +1,60 @@
+#ifndef EZOEC_ASYNC_H
+#define EZOEC_ASYNC_H
+
+#include "ezoec.h"
+#include "thread.h"
+#include <stdint.h>
+
+// Asynchronous EZO commands. Requests are queued and run one at a time, in
+// submission order, by a worker thread that owns the EZO link, so the
+// submitter is free until the completion callback or msg arrives. Blocking
+// ezoec_* calls from other threads take the device lock like the worker does,
+// so they run between requests and hand the link back to the worker.
+
+#ifndef EZOEC_ASYNC_STACKSIZE
+#define EZOEC_ASYNC_STACKSIZE THREAD_STACKSIZE_DEFAULT
+#endif
+#ifndef EZOEC_ASYNC_PRIO
+#define EZOEC_ASYNC_PRIO (THREAD_PRIORITY_MAIN - 1)
+#endif
+#define EZOEC_ASYNC_CMD_LEN 24
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ezoec_req ezoec_req_t;
+
+// Runs on the worker with the link to itself, returns the request result.
+typedef int (*ezoec_op_t)(ezoec_t *ec, ezoec_req_t *req);
+typedef void (*ezoec_done_cb_t)(ezoec_req_t *req);
+
+// Zero-initialise, then set the completion fields before submitting. The
+// request must stay valid until it completed.
+struct ezoec_req {
+    ezoec_req_t *next;              // Queue link, owned by the worker while queued
+    ezoec_op_t op;                  // Set by ezoec_async_cmd()/_measure(), or a custom op
+    char cmd[EZOEC_ASYNC_CMD_LEN];  // Command line of ezoec_async_cmd(), without '\r'
+    char *out;                      // Optional buffer for a response line
+    uint8_t out_len;                //
+    uint32_t timeout;               // Response line timeout (ms)
+    uint32_t value;                 // Reading of ezoec_async_measure() (nS)
+    void *arg;                      // Free for the submitter and custom ops
+    volatile int result;            // -EINPROGRESS while queued, then the op result
+    ezoec_done_cb_t cb;             // Called on the worker when done, or when NULL ...
+    kernel_pid_t target;            // ... a msg is sent to this thread (if set), dropped if its queue is full
+    uint16_t msg_type;              // with content.ptr pointing at the request
+};
+
+int ezoec_async_init(ezoec_t *ec);
+int ezoec_async_submit(ezoec_t *ec, ezoec_req_t *req);
+int ezoec_async_cmd(ezoec_t *ec, ezoec_req_t *req, const char *format, ...);
+int ezoec_async_measure(ezoec_t *ec, ezoec_req_t *req);
+int ezoec_async_pending(const ezoec_t *ec);
+int ezoec_async_stream(ezoec_t *ec, kernel_pid_t target, uint16_t msg_type);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* end of include guard: EZOEC_ASYNC_H */
@@ -0,0 +1,83 @@
+#ifndef EZOEC_PARSER_H
+#define EZOEC_PARSER_H
+
+#include <stdint.h>
+
+// Line reader for EZO-EC UART output. Bytes are fed as they are received and
+// copied into a line buffer, at every line end the line is matched against the
+// status strings or scanned as a reading and a typed event comes out. Free of
+// RIOT dependencies so it can be tested on the host (tests/test_ezoec_parser.c).
+
+#define EZOEC_PARSER_DECIMALS 3  // Readings are fixed-point with this many decimals (uS -> nS)
+#define EZOEC_PARSER_LINE_MAX 42 // Longest line classified, same as RX_MAX_LINE_LEN
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    EZOEC_STATUS_OK,
+    EZOEC_STATUS_ERROR,
+    EZOEC_STATUS_OVERVOLT,
+    EZOEC_STATUS_UNDERVOLT,
+    EZOEC_STATUS_RESET,
+    EZOEC_STATUS_READY,
+    EZOEC_STATUS_SLEEP,
+    EZOEC_STATUS_WAKE,
+    EZOEC_STATUS_DONE,
+    EZOEC_STATUS_UNKNOWN,
+} ezoec_status_t;
+
+typedef enum {
+    EZOEC_EVT_STATUS,  // *OK, *ER, ... in .status
+    EZOEC_EVT_READING, // Line starting with a number, first field in .value
+    EZOEC_EVT_LINE,    // Anything else (export lines, ?i,... replies, garbled readings), see .len
+} ezoec_evt_type_t;
+
+typedef struct {
+    ezoec_evt_type_t type;
+    ezoec_status_t status;
+    uint32_t value;    // Reading scaled by 10^EZOEC_PARSER_DECIMALS
+    uint8_t len;       // Line length, also for readings
+    uint8_t truncated; // Line did not fit the line buffer
+} ezoec_evt_t;
+
+typedef struct {
+    char buf[EZOEC_PARSER_LINE_MAX + 1]; // Current line, terminated at the line end
+    uint8_t len;
+    char *line;                          // Optional, receives a copy of each raw line (not terminated)
+    uint8_t line_cap;
+} ezoec_parser_t;
+
+void ezoec_parser_reset(ezoec_parser_t *p);
+void ezoec_parser_set_line(ezoec_parser_t *p, char *line, uint8_t cap);
+int ezoec_parser_end_line(ezoec_parser_t *p, ezoec_evt_t *evt);
+
+/**
+ * @brief Feeds one received byte. Inline as it runs for every byte on the
+ * link, only the line end is out of line.
+ *
+ * @return 1 if a line ended and @p evt was filled, 0 otherwise. Empty lines
+ * produce no event.
+ */
+static inline int ezoec_parser_feed(ezoec_parser_t *p, uint8_t byte, ezoec_evt_t *evt) {
+    if (byte == '\r') {
+        return ezoec_parser_end_line(p, evt);
+    }
+    if (byte == '\n') {
+        return 0;
+    }
+
+    uint8_t len = p->len;
+    if (len < EZOEC_PARSER_LINE_MAX) {
+        p->buf[len] = byte;
+    }
+    p->len = (len < UINT8_MAX) ? len + 1 : len;
+    return 0;
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* end of include guard: EZOEC_PARSER_H */
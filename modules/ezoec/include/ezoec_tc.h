@@ -0,0 +1,19 @@
+#ifndef EZOEC_TC_H
+#define EZOEC_TC_H
+
+#include <stdint.h>
+
+// Firmware temperature compensation, integer only. The table behind it is
+// generated from the reference solutions by gen_tc_lut.py.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t ezoec_tc_normalise(uint32_t nS, int16_t centi_C);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* end of include guard: EZOEC_TC_H */
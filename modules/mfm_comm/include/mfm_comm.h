@@ -1,12 +1,14 @@
 #ifndef APP_MFM_COMM_H
 #define APP_MFM_COMM_H
 
+#include "modules.h"
 #include "periph/i2c.h"
 #include "sched.h"
 #include <stdint.h>
 
 typedef int (*mfm_comm_sensor_init_fn)(void *arg);
 typedef int (*mfm_comm_perform_measurement_fn)(void *arg);
+typedef uint16_t (*mfm_comm_measurement_time_fn)(void *arg);
 
 typedef struct mfm_comm_params_t mfm_comm_params_t;
 struct mfm_comm_params_t {
@@ -17,8 +19,18 @@ struct mfm_comm_params_t {
     uint8_t sensor_count;
     mfm_comm_sensor_init_fn sensor_init_fn;
     mfm_comm_perform_measurement_fn perform_measurement_fn;
+    // Optional, estimates REG_MEAS_TIME (ms) from the selected type and
+    // samples. Runs in the I2C ISR, 0 falls back to measurement_time.
+    mfm_comm_measurement_time_fn measurement_time_fn;
 };
 
+// Time spent in an I2C callback, kept with the mfm_comm_stats module.
+typedef struct {
+    uint32_t count;    // Calls
+    uint32_t total_us; // Sum, for the mean
+    uint16_t max_us;   // Worst case
+} mfm_comm_isr_stat_t;
+
 typedef struct mfm_comm_t mfm_comm_t;
 struct mfm_comm_t {
     mfm_comm_params_t params;
@@ -39,6 +51,11 @@ struct mfm_comm_t {
     // Measurement results buffer.
     void *payload;
     uint8_t payload_len;
+
+#if IS_USED(MODULE_MFM_COMM_STATS)
+    mfm_comm_isr_stat_t isr_prepare; // Address phase: lookup, read handler, CRC
+    mfm_comm_isr_stat_t isr_finish;  // End of a write: CRC check, write handler
+#endif
 };
 
 typedef enum {
@@ -0,0 +1,52 @@
+#ifndef APP_MFM_COMM_REGS_H
+#define APP_MFM_COMM_REGS_H
+
+// The MFM register map, declared once. Expand MFM_COMM_REGISTERS with an
+// X(name, id, write_size, read_fn, write_fn) macro to generate what you need:
+// the firmware builds its reg_id_t, descriptor table and id index from it,
+// host tooling only has to look at the first three columns.
+//
+//  name        register, REG_<name> in reg_id_t
+//  id          register address on the bus, below MFM_COMM_REG_ID_LIMIT
+//  write_size  data bytes a write needs (without CRC), 0 when read-only
+//  read_fn     read handler, NULL if the register can not be read
+//  write_fn    write handler, NULL if the register can not be written
+
+#define MFM_COMM_REGISTERS(X)                                                      \
+    X(FIRMWARE_VERSION, 0x01, 0, read_firmware_version, NULL)                      \
+    X(PROTOCOL_VERSION, 0x02, 0, read_protocol_version, NULL)                      \
+    X(SENSOR_TYPE,      0x03, 0, read_sensor_type,      NULL)                      \
+    X(INIT_START,       0x0A, 1, read_init_start,       write_init_start)          \
+    X(INIT_STATUS,      0x0B, 1, read_init_status,      NULL)                      \
+    X(MEAS_START,       0x10, 1, read_meas_start,       write_meas_start)          \
+    X(MEAS_STATUS,      0x11, 0, read_meas_status,      NULL)                      \
+    X(MEAS_TIME,        0x12, 2, read_meas_time,        write_meas_time)           \
+    X(MEAS_DATA,        0x20, 0, read_meas_data,        NULL)                      \
+    X(SENSOR_AMOUNT,    0x30, 0, read_sensor_amount,    NULL)                      \
+    X(SENSOR_SELECTED,  0x31, 1, read_sensor_selected,  write_sensor_selected)     \
+    X(MEAS_TYPE,        0x32, 1, read_meas_type,        write_meas_type)           \
+    X(MEAS_SAMPLES,     0x33, 1, read_meas_samples,     write_meas_samples)        \
+    X(SENSOR_DATA,      0x38, 0, read_sensor_data,      NULL)                      \
+    X(CONTROL_IO,       0x40, 0, NULL,                  NULL)                      \
+    X(DIRECTION_IO,     0x41, 0, NULL,                  NULL)                      \
+    X(ERROR_COUNT,      0x50, 0, read_error_count,      NULL)                      \
+    X(ERROR_STATUS,     0x51, 1, read_error_status,     write_error_status)
+
+// One past the highest register id, the size of a table indexed by id. Each
+// register adds a char[id + 1] member, the union is as large as the largest.
+#define MFM_COMM_REG_SPAN(name, id, write_size, read_fn, write_fn) char name[(id) + 1];
+union mfm_comm_reg_span {
+    MFM_COMM_REGISTERS(MFM_COMM_REG_SPAN)
+};
+#undef MFM_COMM_REG_SPAN
+#define MFM_COMM_REG_ID_LIMIT (sizeof(union mfm_comm_reg_span))
+
+// The largest write_size, same trick
+#define MFM_COMM_REG_WRITE_SPAN(name, id, write_size, read_fn, write_fn) char name[(write_size) + 1];
+union mfm_comm_reg_write_span {
+    MFM_COMM_REGISTERS(MFM_COMM_REG_WRITE_SPAN)
+};
+#undef MFM_COMM_REG_WRITE_SPAN
+#define MFM_COMM_REG_WRITE_MAX (sizeof(union mfm_comm_reg_write_span) - 1)
+
+#endif /* end of include guard: APP_MFM_COMM_REGS_H */
@@ -1,5 +1,10 @@
 #include "mfm_comm.h"
+#include "mfm_comm_crc.h"
+#include "mfm_comm_regs.h"
+#ifndef CPU_NATIVE
 #include "periph/cpu_gpio.h"
+#endif
+#include "irq.h"
 #include "periph/gpio.h"
 #include "periph/i2c.h"
 #include "sched.h"
@@ -30,8 +35,6 @@ enum { max_payload_len = 36 };
 // Forward definitions
 // ==========================
 
-uint16_t calculateCRC_CCITT(uint8_t *data, int length);
-
 int read_firmware_version(mfm_comm_t *comm, uint8_t *data);
 int read_protocol_version(mfm_comm_t *comm, uint8_t *data);
 int read_sensor_type(mfm_comm_t *comm, uint8_t *data);
@@ -62,24 +65,9 @@ void write_error_status(mfm_comm_t *comm, uint8_t *data, uint8_t len);
 // ==========================
 
 typedef enum {
-    REG_FIRMWARE_VERSION = 0x01,
-    REG_PROTOCOL_VERSION,
-    REG_SENSOR_TYPE,
-    REG_INIT_START = 0x0A,
-    REG_INIT_STATUS,
-    REG_MEAS_START = 0x10,
-    REG_MEAS_STATUS,
-    REG_MEAS_TIME,
-    REG_MEAS_DATA     = 0x20,
-    REG_SENSOR_AMOUNT = 0x30,
-    REG_SENSOR_SELECTED,
-    REG_MEAS_TYPE,
-    REG_MEAS_SAMPLES,
-    REG_SENSOR_DATA = 0x38,
-    REG_CONTROL_IO  = 0x40,
-    REG_DIRECTION_IO,
-    REG_ERROR_COUNT = 0x50,
-    REG_ERROR_STATUS,
+#define X(name, id, write_size, read_fn, write_fn) REG_##name = id,
+    MFM_COMM_REGISTERS(X)
+#undef X
 } reg_id_t;
 
 typedef int (*reg_read_func_t)(mfm_comm_t *comm, uint8_t *data);
@@ -105,57 +93,151 @@ typedef enum {
 #define CRC_BYTES  2
 #define DATA_BYTES 52
 #define REG_BYTES  1
-// In case of READ, buffer is prefixed with a byte indicating the lenght of the
-// data and suffixed with 2 CRC bytes In case of WRITE, buffer is prefixed with
-// the register byte and suffixed with 2 CRC bytes
-// #define BUFFER_SIZE LEN_BYTES + DATA_BYTES + CRC_BYTES
-#define BUFFER_SIZE 255
+// A read response is the register data suffixed with 2 CRC bytes, the largest
+// is REG_MEAS_DATA: a length byte and the measurement payload. A write frame
+// is prefixed with the register byte for the CRC calculation and suffixed with
+// 2 CRC bytes. Reads and writes have separate buffers, so a read that gets in
+// between the address phase and the end of a write can not clobber it.
+#define FRAME_SIZE     (LEN_BYTES + max_payload_len + CRC_BYTES)
+#define WR_BUFFER_SIZE (REG_BYTES + MFM_COMM_REG_WRITE_MAX + CRC_BYTES)
 
 // ==========================
 // Register implementation
 // ==========================
 
+// Position of each register in registers[]
+enum {
+#define X(name, id, write_size, read_fn, write_fn) REG_POS_##name,
+    MFM_COMM_REGISTERS(X)
+#undef X
+    REG_POS_COUNT,
+};
+
 const reg_desc_t registers[] = {
-    {REG_FIRMWARE_VERSION, 0, read_firmware_version, NULL                 },
-    {REG_PROTOCOL_VERSION, 0, read_protocol_version, NULL                 },
-    {REG_SENSOR_TYPE,      0, read_sensor_type,      NULL                 },
-    {REG_INIT_START,       1, read_init_start,       write_init_start     },
-    {REG_INIT_STATUS,      1, read_init_status,      NULL                 },
-    {REG_MEAS_START,       1, read_meas_start,       write_meas_start     },
-    {REG_MEAS_STATUS,      0, read_meas_status,      NULL                 },
-    {REG_MEAS_TIME,        2, read_meas_time,        write_meas_time      },
-    {REG_MEAS_DATA,        0, read_meas_data,        NULL                 },
-    {REG_SENSOR_AMOUNT,    0, read_sensor_amount,    NULL                 },
-    {REG_SENSOR_SELECTED,  1, read_sensor_selected,  write_sensor_selected},
-    {REG_MEAS_TYPE,        1, read_meas_type,        write_meas_type      },
-    {REG_MEAS_SAMPLES,     1, read_meas_samples,     write_meas_samples   },
-    {REG_SENSOR_DATA,      0, read_sensor_data,      NULL                 },
-    {REG_CONTROL_IO,       0, NULL,                  NULL                 },
-    {REG_DIRECTION_IO,     0, NULL,                  NULL                 },
-    {REG_ERROR_COUNT,      0, read_error_count,      NULL                 },
-    {REG_ERROR_STATUS,     1, read_error_status,     write_error_status   },
+#define X(name, id, write_size, read_fn, write_fn) [REG_POS_##name] = {REG_##name, write_size, read_fn, write_fn},
+    MFM_COMM_REGISTERS(X)
+#undef X
 };
 const size_t reg_count = sizeof(registers) / sizeof(reg_desc_t);
 
-const reg_desc_t *find_register(uint8_t id) {
-    for (unsigned i = 0; i < reg_count; i++) {
-        if (registers[i].id == id)
-            return &registers[i];
-    }
-    return NULL;
+// Sparse index from register id to position + 1, 0 for unknown ids. Looked up
+// twice per transaction in the I2C ISR, so it is a single bounded table read.
+static const uint8_t reg_index[MFM_COMM_REG_ID_LIMIT] = {
+#define X(name, id, write_size, read_fn, write_fn) [REG_##name] = REG_POS_##name + 1,
+    MFM_COMM_REGISTERS(X)
+#undef X
+};
+_Static_assert(REG_POS_COUNT < UINT8_MAX, "reg_index holds positions as uint8_t");
+
+const reg_desc_t *find_register(uint16_t id) {
+    if (id >= MFM_COMM_REG_ID_LIMIT || reg_index[id] == 0)
+        return NULL;
+    return &registers[reg_index[id] - 1];
 }
 
-static uint8_t buffer[BUFFER_SIZE] = {0};
+static uint8_t rd_buffer[FRAME_SIZE]     = {0};
+static uint8_t wr_buffer[WR_BUFFER_SIZE] = {0};
 static i2c_slave_fsm_t i2c_slave;
 
+// ==========================
+// Prebuilt read responses
+// ==========================
+
+// The firmware version, the sensor type and the measurement results are built
+// with their CRC ahead of time, the ISR only hands out a pointer. The results
+// are double buffered: the next frame goes to the back buffer and is swapped
+// in with IRQs masked, so a master that is still clocking out the previous
+// frame is not disturbed, and data and status always change together. The
+// frame of the read in flight is tracked, so two updates in a row can not
+// rebuild it under the master either.
+//
+// Each frame is sized for the longest response of its register, only the
+// measurement data needs all of FRAME_SIZE.
+#define FIRMWARE_VERSION_MAX 10
+#define FIRMWARE_FRAME_SIZE  (FIRMWARE_VERSION_MAX + CRC_BYTES)
+#define SENSOR_FRAME_SIZE    (2 + CRC_BYTES)
+#define STATUS_FRAME_SIZE    (1 + CRC_BYTES)
+
+typedef struct {
+    uint8_t len;    // Data and CRC
+    uint8_t data[]; // Sized by FRAME_STORAGE()
+} frame_t;
+
+// Storage for a frame of up to @p size bytes of data and CRC
+#define FRAME_STORAGE(size)                                                                                            \
+    union {                                                                                                            \
+        frame_t frame;                                                                                                 \
+        uint8_t raw[1 + (size)];                                                                                       \
+    }
+
+typedef struct {
+    frame_t *buf[2];
+    uint8_t front; // The one the ISR hands out
+} frame_pair_t;
+
+static FRAME_STORAGE(FIRMWARE_FRAME_SIZE) firmware_version_frame;
+static FRAME_STORAGE(SENSOR_FRAME_SIZE) sensor_type_frame;
+static FRAME_STORAGE(FRAME_SIZE) meas_data_a, meas_data_b;
+static FRAME_STORAGE(STATUS_FRAME_SIZE) meas_status_a, meas_status_b;
+static frame_pair_t meas_data_frames   = {.buf = {&meas_data_a.frame, &meas_data_b.frame}};
+static frame_pair_t meas_status_frames = {.buf = {&meas_status_a.frame, &meas_status_b.frame}};
+
+static void frame_build(mfm_comm_t *comm, frame_t *frame, reg_id_t id) {
+    int len              = find_register(id)->read_fn(comm, frame->data);
+    uint16_t crc         = calculateCRC_CCITT(frame->data, len);
+    frame->data[len]     = (crc >> 8) & 0xFF;
+    frame->data[len + 1] = crc & 0xFF;
+    frame->len           = len + CRC_BYTES;
+}
+
+// Handed out to the read in flight, NULL once it finished. A read the master
+// abandons leaves it set, which only costs an in place rebuild below.
+static frame_t *frame_reading;
+
+// Builds the next frame of @p pair and swaps it in, call with IRQs masked.
+static void frame_publish(mfm_comm_t *comm, frame_pair_t *pair, reg_id_t id) {
+    frame_t *back = pair->buf[pair->front ^ 1];
+    if (back == frame_reading) {
+        // The read of the previous front still streams. It is the only one,
+        // and none can start while IRQs are masked, so rebuild the front.
+        frame_build(comm, pair->buf[pair->front], id);
+        return;
+    }
+    frame_build(comm, back, id);
+    pair->front ^= 1;
+}
+
+// Called from the ISR (a master starting a measurement) and from the thread.
+static void publish_status(mfm_comm_t *comm, uint8_t status) {
+    unsigned state           = irq_disable();
+    comm->measurement_status = status;
+    frame_publish(comm, &meas_status_frames, REG_MEAS_STATUS);
+    irq_restore(state);
+}
+
+static frame_t *frame_prebuilt(uint16_t reg_id) {
+    switch (reg_id) {
+    case REG_FIRMWARE_VERSION:
+        return &firmware_version_frame.frame;
+    case REG_SENSOR_TYPE:
+        return &sensor_type_frame.frame;
+    case REG_MEAS_DATA:
+        return meas_data_frames.buf[meas_data_frames.front];
+    case REG_MEAS_STATUS:
+        return meas_status_frames.buf[meas_status_frames.front];
+    default:
+        return NULL;
+    }
+}
+
 // ==========================
 // Readable register functions
 // ==========================
 
 int read_firmware_version(mfm_comm_t *comm, uint8_t *data) {
     uint8_t data_len = strlen(comm->params.firmware_version);
-    if (data_len > 10)
-        data_len = 10;
+    if (data_len > FIRMWARE_VERSION_MAX)
+        data_len = FIRMWARE_VERSION_MAX;
     memcpy(data, (uint8_t *)comm->params.firmware_version, data_len);
     return data_len;
 }
@@ -192,8 +274,15 @@ int read_meas_status(mfm_comm_t *comm, uint8_t *data) {
 }
 
 int read_meas_time(mfm_comm_t *comm, uint8_t *data) {
-    data[0] = comm->params.measurement_time & 0xFF;
-    data[1] = (comm->params.measurement_time >> 8) & 0xFF;
+    uint16_t time = comm->params.measurement_time;
+    if (comm->params.measurement_time_fn != NULL) {
+        uint16_t estimate = comm->params.measurement_time_fn(comm);
+        if (estimate > 0) {
+            time = estimate;
+        }
+    }
+    data[0] = time & 0xFF;
+    data[1] = (time >> 8) & 0xFF;
     return 2;
 }
 
@@ -204,8 +293,8 @@ int read_meas_data(mfm_comm_t *comm, uint8_t *data) {
     }
 
     uint8_t copy_len = comm->payload_len;
-    if (copy_len > (BUFFER_SIZE - 1 - CRC_BYTES)) {
-        copy_len = (BUFFER_SIZE - 1 - CRC_BYTES);
+    if (copy_len > max_payload_len) {
+        copy_len = max_payload_len;
     }
     data[0] = copy_len;
     memcpy(data + 1, comm->payload, copy_len);
@@ -287,13 +376,13 @@ void write_meas_start(mfm_comm_t *comm, uint8_t *data, uint8_t len) {
     (void)len;
 
     // Enable measuring flag.
-    comm->measurement_status = COMMAND_ACTIVE;
+    publish_status(comm, COMMAND_ACTIVE);
 
     // Trigger a measurement.
     int result = comm->params.perform_measurement_fn(comm);
     if (result < 0) {
-        comm->error              = -result;
-        comm->measurement_status = COMMAND_ERROR;
+        comm->error = -result;
+        publish_status(comm, COMMAND_ERROR);
         return;
     }
 
@@ -335,7 +424,7 @@ void write_error_status(mfm_comm_t *comm, uint8_t *data, uint8_t len) {
 // Core I2C & MFM Protocol logic
 // ==========================
 
-static uint8_t i2c_prepare(uint8_t read, uint16_t addr, uint16_t reg_id, uint8_t **data_ptr, void *arg) {
+static uint8_t handle_prepare(uint8_t read, uint16_t addr, uint16_t reg_id, uint8_t **data_ptr, void *arg) {
     (void)addr;
 
     mfm_comm_t *comm      = arg;
@@ -348,19 +437,27 @@ static uint8_t i2c_prepare(uint8_t read, uint16_t addr, uint16_t reg_id, uint8_t
 
     // Master is reading from this register.
     if (read) {
-        *data_ptr = buffer;
+        // Built ahead of time, nothing to do but hand it out.
+        frame_t *frame = frame_prebuilt(reg_id);
+        if (frame != NULL) {
+            frame_reading = frame;
+            *data_ptr     = frame->data;
+            return frame->len;
+        }
+
+        *data_ptr = rd_buffer;
 
         // Not a read-capable register.
         if (reg->read_fn == NULL)
             return 0;
 
         // Prepare buffer with read values.
-        int len = reg->read_fn(comm, buffer);
+        int len = reg->read_fn(comm, rd_buffer);
 
         // Calculate CRC and append to data
-        uint16_t crc    = calculateCRC_CCITT(buffer, len);
-        buffer[len]     = (crc >> 8) & 0xFF;
-        buffer[len + 1] = crc & 0xFF;
+        uint16_t crc       = calculateCRC_CCITT(rd_buffer, len);
+        rd_buffer[len]     = (crc >> 8) & 0xFF;
+        rd_buffer[len + 1] = crc & 0xFF;
 
         return len + CRC_BYTES;
     }
@@ -371,18 +468,20 @@ static uint8_t i2c_prepare(uint8_t read, uint16_t addr, uint16_t reg_id, uint8_t
 
     // Master is writing to this register. Append register ID for CRC
     // calculation in i2c_finish and add CRC byte len to expected read size.
-    buffer[0] = reg_id;
-    *data_ptr = &buffer[1];
+    wr_buffer[0] = reg_id;
+    *data_ptr    = &wr_buffer[REG_BYTES];
 
     return reg->write_size + CRC_BYTES;
 }
 
-static void i2c_finish(uint8_t read, uint16_t addr, uint16_t reg_id, size_t len, void *arg) {
+static void handle_finish(uint8_t read, uint16_t addr, uint16_t reg_id, size_t len, void *arg) {
     (void)addr;
 
-    // Nothing to do if a read finishes.
-    if (read)
+    // The frame of a finished read may be rebuilt again.
+    if (read) {
+        frame_reading = NULL;
         return;
+    }
 
     // Get the relevant register descriptor.
     const reg_desc_t *reg = find_register(reg_id);
@@ -400,14 +499,14 @@ static void i2c_finish(uint8_t read, uint16_t addr, uint16_t reg_id, size_t len,
         return;
 
     // Skips the "reg" byte, which is used for CRC calc I2C master writes to
-    // buffer[1...]
-    uint8_t *data = &buffer[REG_BYTES];
+    // wr_buffer[1...]
+    uint8_t *data = &wr_buffer[REG_BYTES];
 
-    // Note: len does NOT include REG_BYTE at buffer[0] Validate Checksum.
+    // Note: len does NOT include REG_BYTE at wr_buffer[0] Validate Checksum.
     uint16_t crc = (data[len - 2] << 8) | data[len - 1];
 
     // If the CRC is incorrect do nothing.
-    if (crc != calculateCRC_CCITT(buffer, len + REG_BYTES - CRC_BYTES)) {
+    if (crc != calculateCRC_CCITT(wr_buffer, len + REG_BYTES - CRC_BYTES)) {
         return;
     }
 
@@ -421,6 +520,36 @@ static void i2c_finish(uint8_t read, uint16_t addr, uint16_t reg_id, size_t len,
     reg->write_fn(comm, data, len - CRC_BYTES);
 }
 
+#if IS_USED(MODULE_MFM_COMM_STATS)
+// Both callbacks run in the I2C ISR, time them to see the worst case.
+static void isr_stat_add(mfm_comm_isr_stat_t *stat, uint32_t start) {
+    uint32_t us = ztimer_now(ZTIMER_USEC) - start;
+    stat->count++;
+    stat->total_us += us;
+    if (us > stat->max_us) {
+        stat->max_us = us > UINT16_MAX ? UINT16_MAX : us;
+    }
+}
+
+static uint8_t i2c_prepare(uint8_t read, uint16_t addr, uint16_t reg_id, uint8_t **data_ptr, void *arg) {
+    mfm_comm_t *comm = arg;
+    uint32_t start   = ztimer_now(ZTIMER_USEC);
+    uint8_t len      = handle_prepare(read, addr, reg_id, data_ptr, arg);
+    isr_stat_add(&comm->isr_prepare, start);
+    return len;
+}
+
+static void i2c_finish(uint8_t read, uint16_t addr, uint16_t reg_id, size_t len, void *arg) {
+    mfm_comm_t *comm = arg;
+    uint32_t start   = ztimer_now(ZTIMER_USEC);
+    handle_finish(read, addr, reg_id, len, arg);
+    isr_stat_add(&comm->isr_finish, start);
+}
+#else
+#define i2c_prepare handle_prepare
+#define i2c_finish  handle_finish
+#endif
+
 int read_slot_id(void) {
 #if !defined(MFM_COMM_ID1_PIN) || !defined(MFM_COMM_ID2_PIN) || !defined(MFM_COMM_ID3_PIN)
     return 0;
@@ -441,6 +570,14 @@ kernel_pid_t mfm_comm_init(mfm_comm_t *comm, const mfm_comm_params_t params) {
     comm->is_already_initialized = 1;
 
     comm->params = params;
+    mfm_comm_crc_init();
+
+    // Responses exist before the master can ask for them.
+    frame_build(comm, &firmware_version_frame.frame, REG_FIRMWARE_VERSION);
+    frame_build(comm, &sensor_type_frame.frame, REG_SENSOR_TYPE);
+    frame_build(comm, meas_data_frames.buf[meas_data_frames.front], REG_MEAS_DATA);
+    frame_build(comm, meas_status_frames.buf[meas_status_frames.front], REG_MEAS_STATUS);
+
     DEBUG("[%s] r slv\n", __func__);
     i2c_slave_reg(&i2c_slave, i2c_prepare, i2c_finish, 0, comm);
 
@@ -473,51 +610,21 @@ int mfm_comm_measurement_finish(mfm_comm_t *comm, void *payload, uint8_t payload
         return -EINVAL;
     }
 
-    comm->payload            = payload;
-    comm->payload_len        = payload_len;
-    comm->measurement_status = COMMAND_DONE;
+    comm->payload     = payload;
+    comm->payload_len = payload_len;
+
+    // Data and status in one critical section, a master never sees DONE with
+    // old data. The data frame is a memcpy and a CRC over at most FRAME_SIZE.
+    unsigned state = irq_disable();
+    frame_publish(comm, &meas_data_frames, REG_MEAS_DATA);
+    publish_status(comm, COMMAND_DONE);
+    irq_restore(state);
 
     return 0;
 }
 
 void mfm_comm_measurement_error(mfm_comm_t *comm, uint8_t err) {
-    comm->error              = MFM_COMM_ERR_APP;
-    comm->app_error          = err;
-    comm->measurement_status = COMMAND_ERROR;
-}
-
-static const uint16_t CRC16Table[] = {
-    0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241, 0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1,
-    0xC481, 0x0440, 0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40, 0x0A00, 0xCAC1, 0xCB81, 0x0B40,
-    0xC901, 0x09C0, 0x0880, 0xC841, 0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40, 0x1E00, 0xDEC1,
-    0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41, 0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
-    0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040, 0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1,
-    0xF281, 0x3240, 0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441, 0x3C00, 0xFCC1, 0xFD81, 0x3D40,
-    0xFF01, 0x3FC0, 0x3E80, 0xFE41, 0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840, 0x2800, 0xE8C1,
-    0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41, 0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
-    0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640, 0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0,
-    0x2080, 0xE041, 0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240, 0x6600, 0xA6C1, 0xA781, 0x6740,
-    0xA501, 0x65C0, 0x6480, 0xA441, 0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41, 0xAA01, 0x6AC0,
-    0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840, 0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
-    0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40, 0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1,
-    0xB681, 0x7640, 0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041, 0x5000, 0x90C1, 0x9181, 0x5140,
-    0x9301, 0x53C0, 0x5280, 0x9241, 0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440, 0x9C01, 0x5CC0,
-    0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40, 0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
-    0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40, 0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0,
-    0x4C80, 0x8C41, 0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641, 0x8201, 0x42C0, 0x4380, 0x8341,
-    0x4100, 0x81C1, 0x8081, 0x4040};
-
-/**
- * @brief Calculate the CRC CCITT
- * @param data The message to calculate the CRC from
- * @param length The lenght of the message
- * @return The 16 bits CRC
- */
-#define CRC16INITVALUE 0xFFFF // Initial CRC value
-uint16_t calculateCRC_CCITT(uint8_t *data, int length) {
-    uint16_t crc = CRC16INITVALUE;
-    while (length--)
-        crc = (crc >> 8) ^ CRC16Table[*data++ ^ (crc & 0xFF)];
-    uint16_t temp = ((crc << 8) & 0xFF00) | (crc >> 8); // swap
-    return temp;
+    comm->error     = MFM_COMM_ERR_APP;
+    comm->app_error = err;
+    publish_status(comm, COMMAND_ERROR);
 }
@@ -0,0 +1,32 @@
+#ifndef MFM_COMM_CRC_H
+#define MFM_COMM_CRC_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The MFM frame CRC: CRC-16 with polynomial 0x8005, reflected in and out and
+// initial value 0xFFFF (CRC-16/MODBUS), sent high byte first.
+#define MFM_COMM_CRC_POLY 0x8005
+#define MFM_COMM_CRC_INIT 0xFFFF
+
+/**
+ * @brief Prepares the CRC backend, the STM32 CRC unit with mfm_comm_crc_hw.
+ */
+void mfm_comm_crc_init(void);
+
+/**
+ * @brief Calculate the CRC CCITT
+ * @param data The message to calculate the CRC from
+ * @param length The lenght of the message
+ * @return The 16 bits CRC, byte swapped
+ */
+uint16_t calculateCRC_CCITT(uint8_t *data, int length);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* end of include guard: MFM_COMM_CRC_H */
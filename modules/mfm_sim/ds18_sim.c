@@ -0,0 +1,406 @@
+/*
+ * DS18B20 peers on the simulated 1-Wire pins.
+ *
+ * The driver's bit primitives (reset pulse, write slot, read slot) are routed
+ * here in the host-native build, so everything above them - byte framing, ROM
+ * and function commands, scratchpad layout - runs unmodified against a bit
+ * level model of the sensor. Several devices may share a pin; read slots are
+ * the wired-AND of all devices that drive the bus.
+ */
+#include "mfm_sim.h"
+#include "ztimer.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ENABLE_DEBUG 0
+#include "debug.h"
+
+#define SIM_CMD_CONVERT         0x44
+#define SIM_CMD_RSCRATCHPAD     0xbe
+#define SIM_CMD_WSCRATCHPAD     0x4e
+#define SIM_CMD_COPYSCRATCHPAD  0x48
+#define SIM_CMD_RECALLE         0xb8
+#define SIM_CMD_SEARCHROM       0xf0
+#define SIM_CMD_READROM         0x33
+#define SIM_CMD_MATCHROM        0x55
+#define SIM_CMD_SKIPROM         0xcc
+#define SIM_POWER_ON_RAW        0x0550 // 85 C, what the part reports before its first conversion
+#define SIM_SCRATCHPAD_LEN      9
+
+typedef enum {
+    BUS_IDLE,         // Waiting for a reset pulse
+    BUS_ROM_CMD,      // Expecting a ROM command
+    BUS_MATCH_ROM,    // Receiving the 8 byte ROM of MATCH ROM
+    BUS_SEARCH_ROM,   // SEARCH ROM: bit, complement, direction for each ROM bit
+    BUS_FUNCTION_CMD, // Expecting a function command
+    BUS_READ_ROM,     // Streaming the ROM out
+    BUS_READ_SCRATCH, // Streaming the scratchpad out
+    BUS_WRITE_SCRATCH,
+    BUS_CONVERTING,
+} bus_state_t;
+
+typedef struct {
+    uint8_t used;
+    gpio_t pin;
+    uint8_t rom[8];
+    uint8_t selected;
+    int16_t centi_C;
+    uint16_t raw;
+    uint8_t th, tl, config;
+    uint8_t eeprom[3];
+    uint32_t convert_done;
+    uint8_t converting;
+} sim_ds18_t;
+
+typedef struct {
+    uint8_t used;
+    gpio_t pin;
+    bus_state_t state;
+    uint8_t byte;
+    uint8_t bits;
+    uint8_t index;
+    uint8_t glitches; // Scratchpad reads still to corrupt
+    uint8_t corrupt;  // The current scratchpad read has a flipped bit
+} sim_bus_t;
+
+static sim_ds18_t devices[MFM_SIM_DS18_DEVICES];
+static sim_bus_t buses[MFM_SIM_DS18_DEVICES];
+static uint32_t conversion_ms = 600;
+
+// Dallas/Maxim CRC-8, x^8 + x^5 + x^4 + 1 (reflected 0x8C)
+static uint8_t _crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    while (len--) {
+        uint8_t byte = *data++;
+        for (int i = 0; i < 8; i++) {
+            uint8_t mix = (crc ^ byte) & 0x01;
+            crc >>= 1;
+            if (mix) {
+                crc ^= 0x8C;
+            }
+            byte >>= 1;
+        }
+    }
+    return crc;
+}
+
+static sim_bus_t *_bus(gpio_t pin) {
+    for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+        if (buses[i].used && buses[i].pin == pin) {
+            return &buses[i];
+        }
+    }
+    return NULL;
+}
+
+static uint8_t _resolution(const sim_ds18_t *dev) { return 9 + ((dev->config >> 5) & 0x03); }
+
+static void _update(sim_ds18_t *dev) {
+    if (dev->converting && (int32_t)(ztimer_now(ZTIMER_MSEC) - dev->convert_done) >= 0) {
+        // Latch the temperature at the configured resolution (1/16 C units).
+        int32_t raw = ((int32_t)dev->centi_C * 16) / 100;
+        raw &= ~((1 << (12 - _resolution(dev))) - 1);
+        dev->raw        = (uint16_t)raw;
+        dev->converting = 0;
+    }
+}
+
+static void _scratchpad(sim_ds18_t *dev, uint8_t out[SIM_SCRATCHPAD_LEN]) {
+    _update(dev);
+    out[0] = dev->raw & 0xFF;
+    out[1] = dev->raw >> 8;
+    out[2] = dev->th;
+    out[3] = dev->tl;
+    out[4] = dev->config;
+    out[5] = 0xFF;
+    out[6] = 0x0C;
+    out[7] = 0x10;
+    out[8] = _crc8(out, 8);
+}
+
+// Selection is per bus: the driver may interleave commands on several pins
+static int _on_bus(const sim_ds18_t *dev, const sim_bus_t *bus) {
+    return dev->used && dev->pin == bus->pin;
+}
+
+static int _selected(const sim_ds18_t *dev, const sim_bus_t *bus) {
+    return dev->selected && _on_bus(dev, bus);
+}
+
+static void _handle_byte(sim_bus_t *bus, uint8_t byte) {
+    switch (bus->state) {
+    case BUS_ROM_CMD:
+        if (byte == SIM_CMD_SKIPROM) {
+            for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+                if (_on_bus(&devices[i], bus)) {
+                    devices[i].selected = 1;
+                }
+            }
+            bus->state = BUS_FUNCTION_CMD;
+        } else if (byte == SIM_CMD_MATCHROM) {
+            for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+                if (_on_bus(&devices[i], bus)) {
+                    devices[i].selected = 1;
+                }
+            }
+            bus->index = 0;
+            bus->state = BUS_MATCH_ROM;
+        } else if (byte == SIM_CMD_SEARCHROM) {
+            for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+                if (_on_bus(&devices[i], bus)) {
+                    devices[i].selected = 1;
+                }
+            }
+            bus->index = 0; // ROM bit position
+            bus->bits  = 0; // Slot within the position
+            bus->state = BUS_SEARCH_ROM;
+        } else if (byte == SIM_CMD_READROM) {
+            bus->index = 0;
+            bus->state = BUS_READ_ROM;
+        } else {
+            DEBUG("[ds18_sim] unsupported ROM command 0x%02x\n", byte);
+            bus->state = BUS_IDLE;
+        }
+        break;
+    case BUS_MATCH_ROM:
+        for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+            if (_selected(&devices[i], bus) && devices[i].rom[bus->index] != byte) {
+                devices[i].selected = 0;
+            }
+        }
+        if (++bus->index == 8) {
+            bus->state = BUS_FUNCTION_CMD;
+        }
+        break;
+    case BUS_FUNCTION_CMD:
+        bus->index = 0;
+        switch (byte) {
+        case SIM_CMD_CONVERT:
+            for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+                sim_ds18_t *dev = &devices[i];
+                if (_selected(dev, bus)) {
+                    dev->converting   = 1;
+                    dev->convert_done = ztimer_now(ZTIMER_MSEC) + (conversion_ms >> (12 - _resolution(dev)));
+                }
+            }
+            bus->state = BUS_CONVERTING;
+            break;
+        case SIM_CMD_RSCRATCHPAD:
+            bus->corrupt = bus->glitches > 0;
+            if (bus->corrupt) {
+                bus->glitches--;
+            }
+            bus->state = BUS_READ_SCRATCH;
+            break;
+        case SIM_CMD_WSCRATCHPAD:
+            bus->state = BUS_WRITE_SCRATCH;
+            break;
+        case SIM_CMD_COPYSCRATCHPAD:
+        case SIM_CMD_RECALLE:
+            for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+                sim_ds18_t *dev = &devices[i];
+                if (!_selected(dev, bus)) {
+                    continue;
+                }
+                if (byte == SIM_CMD_COPYSCRATCHPAD) {
+                    dev->eeprom[0] = dev->th;
+                    dev->eeprom[1] = dev->tl;
+                    dev->eeprom[2] = dev->config;
+                } else {
+                    dev->th     = dev->eeprom[0];
+                    dev->tl     = dev->eeprom[1];
+                    dev->config = dev->eeprom[2];
+                }
+            }
+            bus->state = BUS_IDLE;
+            break;
+        default:
+            DEBUG("[ds18_sim] unsupported function command 0x%02x\n", byte);
+            bus->state = BUS_IDLE;
+            break;
+        }
+        break;
+    case BUS_WRITE_SCRATCH:
+        for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+            sim_ds18_t *dev = &devices[i];
+            if (!_selected(dev, bus)) {
+                continue;
+            }
+            if (bus->index == 0) {
+                dev->th = byte;
+            } else if (bus->index == 1) {
+                dev->tl = byte;
+            } else if (bus->index == 2) {
+                dev->config = (byte & 0x60) | 0x1F;
+            }
+        }
+        if (++bus->index == 3) {
+            bus->state = BUS_IDLE;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+int ds18_sim_reset(gpio_t pin) {
+    sim_bus_t *bus = _bus(pin);
+    if (bus == NULL) {
+        return 1; // Nobody pulled the line low: no presence
+    }
+    bus->state = BUS_ROM_CMD;
+    bus->byte  = 0;
+    bus->bits  = 0;
+    bus->index = 0;
+    return 0;
+}
+
+void ds18_sim_write_bit(gpio_t pin, uint8_t bit) {
+    sim_bus_t *bus = _bus(pin);
+    if (bus == NULL) {
+        return;
+    }
+    if (bus->state == BUS_SEARCH_ROM) {
+        // Direction slot: devices that sent the other bit drop out
+        for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+            sim_ds18_t *dev = &devices[i];
+            if (_selected(dev, bus) && ((dev->rom[bus->index / 8] >> (bus->index % 8)) & 0x01) != (bit ? 1 : 0)) {
+                dev->selected = 0;
+            }
+        }
+        bus->bits = 0;
+        if (++bus->index == 64) {
+            bus->state = BUS_FUNCTION_CMD;
+        }
+        return;
+    }
+
+    bus->byte = (bus->byte >> 1) | (bit ? 0x80 : 0);
+    if (++bus->bits == 8) {
+        bus->bits = 0;
+        _handle_byte(bus, bus->byte);
+    }
+}
+
+uint8_t ds18_sim_read_bit(gpio_t pin) {
+    sim_bus_t *bus = _bus(pin);
+    if (bus == NULL) {
+        return 1;
+    }
+
+    uint8_t bit = 1;
+    uint8_t pos = bus->index * 8 + bus->bits;
+    for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+        sim_ds18_t *dev = &devices[i];
+        if (!dev->used || dev->pin != pin) {
+            continue;
+        }
+        switch (bus->state) {
+        case BUS_READ_ROM:
+            bit &= (dev->rom[pos / 8] >> (pos % 8)) & 0x01;
+            break;
+        case BUS_SEARCH_ROM:
+            if (dev->selected && bus->bits < 2) {
+                uint8_t rom_bit = (dev->rom[bus->index / 8] >> (bus->index % 8)) & 0x01;
+                bit &= (bus->bits == 0) ? rom_bit : !rom_bit;
+            }
+            break;
+        case BUS_READ_SCRATCH:
+            if (dev->selected && pos < SIM_SCRATCHPAD_LEN * 8) {
+                uint8_t scratchpad[SIM_SCRATCHPAD_LEN];
+                _scratchpad(dev, scratchpad);
+                bit &= (scratchpad[pos / 8] >> (pos % 8)) & 0x01;
+            }
+            break;
+        case BUS_CONVERTING:
+            _update(dev);
+            if (dev->selected && dev->converting) {
+                bit = 0;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (bus->state == BUS_READ_SCRATCH && bus->corrupt && pos == 0) {
+        bit ^= 1; // Glitch on the LSB of the temperature
+    }
+
+    if (bus->state == BUS_SEARCH_ROM) {
+        bus->bits++;
+    } else if (bus->state == BUS_READ_ROM || bus->state == BUS_READ_SCRATCH) {
+        if (++bus->bits == 8) {
+            bus->bits = 0;
+            bus->index++;
+        }
+    }
+    return bit;
+}
+
+int ds18_sim_add(gpio_t pin, const uint8_t rom[8], int16_t centi_C) {
+    for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+        sim_ds18_t *dev = &devices[i];
+        if (dev->used) {
+            continue;
+        }
+        memset(dev, 0, sizeof(*dev));
+        dev->used    = 1;
+        dev->pin     = pin;
+        dev->centi_C = centi_C;
+        dev->raw     = SIM_POWER_ON_RAW;
+        dev->th      = dev->eeprom[0] = 0x4B;
+        dev->tl      = dev->eeprom[1] = 0x46;
+        dev->config  = dev->eeprom[2] = 0x7F;
+        memcpy(dev->rom, rom, 7);
+        dev->rom[7] = _crc8(dev->rom, 7);
+
+        if (_bus(pin) == NULL) {
+            for (unsigned b = 0; b < MFM_SIM_DS18_DEVICES; b++) {
+                if (!buses[b].used) {
+                    buses[b].used  = 1;
+                    buses[b].pin   = pin;
+                    buses[b].state = BUS_IDLE;
+                    break;
+                }
+            }
+        }
+        return i;
+    }
+    return -1;
+}
+
+int ds18_sim_set_temperature(gpio_t pin, unsigned index, int16_t centi_C) {
+    for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+        if (devices[i].used && devices[i].pin == pin && index-- == 0) {
+            devices[i].centi_C = centi_C;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void ds18_sim_set_conversion_time(uint32_t ms) { conversion_ms = ms; }
+
+int ds18_sim_glitch(gpio_t pin, unsigned reads) {
+    sim_bus_t *bus = _bus(pin);
+    if (bus == NULL) {
+        return -1;
+    }
+    bus->glitches = reads > UINT8_MAX ? UINT8_MAX : reads;
+    return 0;
+}
+
+void ds18_sim_print(void) {
+    printf("DS18B20: conversion %" PRIu32 " ms @ 12 bit\n", conversion_ms);
+    for (unsigned i = 0; i < MFM_SIM_DS18_DEVICES; i++) {
+        sim_ds18_t *dev = &devices[i];
+        if (!dev->used) {
+            continue;
+        }
+        printf("  [%u] pin 0x%x rom %02x%02x%02x%02x%02x%02x%02x%02x: %d cC, %u bit\n", i, (unsigned)dev->pin,
+               dev->rom[0], dev->rom[1], dev->rom[2], dev->rom[3], dev->rom[4], dev->rom[5], dev->rom[6], dev->rom[7],
+               dev->centi_C, _resolution(dev));
+    }
+}
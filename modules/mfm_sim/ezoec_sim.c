@@ -0,0 +1,455 @@
+/*
+ * Scriptable Atlas Scientific EZO-EC peer for the host-native build.
+ *
+ * Bytes written to "LPUART1" are collected into command lines; every complete
+ * line is answered from the simulator thread after the configured latency,
+ * delivering the response bytes through the rx callback the driver registered,
+ * the same way the UART ISR does on the board.
+ *
+ * The probe model is deliberately simple: every probe has a true conductivity
+ * and a cell gain (ppm). The EZO reports `true * gain / cal_gain`, where
+ * `cal_gain` is the gain of the probe that was connected when the EZO was
+ * calibrated (1000000 when uncalibrated). Export/Import round-trip that gain
+ * through a 10 x 12 character blob so calibration swapping behaves like the
+ * real thing.
+ */
+#include "irq.h"
+#include "mfm_sim.h"
+#include "msg.h"
+#include "thread.h"
+#include "ztimer.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ENABLE_DEBUG 0
+#include "debug.h"
+
+#define SIM_LINE_LEN    48
+#define SIM_LINE_QUEUE  4
+#define SIM_CAL_LINES   10
+#define SIM_CAL_LINE    12
+#define SIM_UNITY_PPM   1000000UL
+#define SIM_DEFAULT_K   10 // 1.0
+#define SIM_STREAM_MS   1000 // Reading interval in continuous mode
+
+enum {
+    SIM_MSG_LINE,
+    SIM_MSG_BOOT,
+    SIM_MSG_STREAM,
+};
+
+static struct {
+    // Host side of the link
+    uart_rx_cb_t rx_cb;
+    void *rx_arg;
+    uint32_t host_baud;
+
+    // Device state
+    uint32_t baud;
+    uint8_t powered;
+    uint8_t probe;
+    uint8_t k_value;
+    uint8_t continuous;
+    int32_t temp_cC; // Compensation temperature (T, RT)
+    uint32_t cal_gain_ppm;
+    uint8_t cal_points;
+    uint8_t import_line;
+    char import_buf[SIM_CAL_LINES][SIM_CAL_LINE + 1];
+    uint8_t export_line;
+    uint32_t generation;
+
+    // Scripted environment
+    uint32_t latency[MFM_SIM_LAT_NUMOF];
+    uint32_t conductivity_nS[MFM_SIM_PROBES];
+    uint32_t gain_ppm[MFM_SIM_PROBES];
+    uint32_t noise_nS;
+    uint32_t rng;
+
+    // Line assembly and hand-off to the simulator thread
+    char rx_line[SIM_LINE_LEN];
+    uint8_t rx_len;
+    char queue[SIM_LINE_QUEUE][SIM_LINE_LEN];
+    uint8_t queue_head;
+    uint8_t queue_tail;
+} sim = {
+    .baud            = 115200,
+    .k_value         = SIM_DEFAULT_K,
+    .temp_cC         = 2500,
+    .cal_gain_ppm    = SIM_UNITY_PPM,
+    .latency         = {[MFM_SIM_LAT_BOOT] = 400,
+                        [MFM_SIM_LAT_CMD]    = 20,
+                        [MFM_SIM_LAT_READ]   = 600,
+                        [MFM_SIM_LAT_CAL]    = 600,
+                        [MFM_SIM_LAT_IMPORT] = 20,
+                        [MFM_SIM_LAT_EXPORT] = 20,
+                        [MFM_SIM_LAT_RESET]  = 1000},
+    .conductivity_nS = {1413000, 12880000},
+    .gain_ppm        = {SIM_UNITY_PPM, 1050000},
+    .rng             = 0x2545F491,
+};
+
+static char _stack[THREAD_STACKSIZE_DEFAULT];
+static kernel_pid_t _pid = KERNEL_PID_UNDEF;
+static msg_t _msg_queue[8];
+static ztimer_t _stream_timer;
+static msg_t _stream_msg = {.type = SIM_MSG_STREAM};
+
+static const char *const latency_names[MFM_SIM_LAT_NUMOF] = {
+    "boot", "cmd", "read", "cal", "import", "export", "reset",
+};
+
+// ==================================
+// Output towards the driver
+// ==================================
+
+static void _emit(uint32_t generation, const char *line) {
+    // Drop responses of a previous power cycle or when the baud rates differ,
+    // the host would only see garbage in that case.
+    if (!sim.powered || generation != sim.generation || sim.rx_cb == NULL || sim.host_baud != sim.baud) {
+        return;
+    }
+    DEBUG("[ezoec_sim] >>> %s\n", line);
+    while (*line) {
+        sim.rx_cb(sim.rx_arg, (uint8_t)*line++);
+    }
+    sim.rx_cb(sim.rx_arg, '\r');
+}
+
+static void _delay(mfm_sim_latency_t which) {
+    if (sim.latency[which] > 0) {
+        ztimer_sleep(ZTIMER_MSEC, sim.latency[which]);
+    }
+}
+
+static void _reboot(uint32_t generation) {
+    _emit(generation, "*RS");
+    _delay(MFM_SIM_LAT_RESET);
+    _emit(generation, "*RE");
+}
+
+// Schedules the next continuous mode reading of this power cycle.
+static void _stream_arm(uint32_t generation) {
+    _stream_msg.content.value = generation;
+    ztimer_set_msg(ZTIMER_MSEC, &_stream_timer, SIM_STREAM_MS, &_stream_msg, _pid);
+}
+
+// ==================================
+// Probe model
+// ==================================
+
+static uint32_t _reading_nS(void) {
+    uint64_t value = (uint64_t)sim.conductivity_nS[sim.probe] * sim.gain_ppm[sim.probe] / sim.cal_gain_ppm;
+    if (sim.noise_nS > 0) {
+        // xorshift32, symmetric noise of +/- noise_nS
+        sim.rng ^= sim.rng << 13;
+        sim.rng ^= sim.rng >> 17;
+        sim.rng ^= sim.rng << 5;
+        int64_t offset = (int64_t)(sim.rng % (2 * sim.noise_nS + 1)) - sim.noise_nS;
+        value          = ((int64_t)value + offset < 0) ? 0 : (uint64_t)((int64_t)value + offset);
+    }
+    return (uint32_t)value;
+}
+
+// Formats like the EZO: two decimals below 100 uS, one below 1000 uS and
+// whole uS above that.
+static void _format_reading(char *buf, size_t len, uint32_t nS) {
+    uint32_t uS = nS / 1000;
+    if (uS < 100) {
+        snprintf(buf, len, "%" PRIu32 ".%02" PRIu32, uS, (nS % 1000) / 10);
+    } else if (uS < 1000) {
+        snprintf(buf, len, "%" PRIu32 ".%" PRIu32, uS, (nS % 1000) / 100);
+    } else {
+        snprintf(buf, len, "%" PRIu32, uS);
+    }
+}
+
+static void _cal_line(char *buf, uint32_t gain_ppm, unsigned line) {
+    uint32_t word = (line == 0) ? gain_ppm : gain_ppm ^ (line * 0x9E3779B9UL);
+    snprintf(buf, SIM_CAL_LINE + 1, "%08" PRIX32 "%04X", word, (unsigned)((word >> 16) ^ (word & 0xFFFF) ^ line));
+}
+
+static int _cal_decode(void) {
+    char expected[SIM_CAL_LINE + 1];
+    // First 8 characters hold the gain, the trailing 4 a check word.
+    char head[9] = {0};
+    memcpy(head, sim.import_buf[0], 8);
+    uint32_t gain = strtoul(head, NULL, 16);
+    if (gain == 0) {
+        return -1;
+    }
+    for (unsigned line = 0; line < SIM_CAL_LINES; line++) {
+        _cal_line(expected, gain, line);
+        if (strncmp(expected, sim.import_buf[line], SIM_CAL_LINE) != 0) {
+            return -1;
+        }
+    }
+    sim.cal_gain_ppm = gain;
+    sim.cal_points   = 2;
+    return 0;
+}
+
+// ==================================
+// Command handling
+// ==================================
+
+static void _handle_line(uint32_t generation, char *line) {
+    char buf[SIM_LINE_LEN];
+    DEBUG("[ezoec_sim] <<< %s\n", line);
+
+    if (strcmp(line, "Export") != 0) {
+        sim.export_line = 0;
+    }
+    if (strncmp(line, "Import,", 7) != 0) {
+        sim.import_line = 0;
+    }
+
+    if (strcmp(line, "i") == 0) {
+        _delay(MFM_SIM_LAT_CMD);
+        _emit(generation, "?i,EC,2.16");
+    } else if (strcmp(line, "R") == 0 || strncmp(line, "RT,", 3) == 0) {
+        // The probe model has no temperature, RT only records it
+        if (line[1] == 'T') {
+            sim.temp_cC = (int32_t)(strtod(line + 3, NULL) * 100);
+        }
+        _delay(MFM_SIM_LAT_READ);
+        _format_reading(buf, sizeof(buf), _reading_nS());
+        _emit(generation, buf);
+    } else if (strcmp(line, "K,?") == 0) {
+        _delay(MFM_SIM_LAT_CMD);
+        snprintf(buf, sizeof(buf), "?K,%u.%u", sim.k_value / 10, sim.k_value % 10);
+        _emit(generation, buf);
+    } else if (strncmp(line, "K,", 2) == 0) {
+        _delay(MFM_SIM_LAT_CMD);
+        char *end;
+        unsigned long whole = strtoul(line + 2, &end, 10);
+        unsigned long tenth = (*end == '.') ? (unsigned long)(end[1] - '0') : 0;
+        sim.k_value         = whole * 10 + tenth;
+    } else if (strcmp(line, "Cal,?") == 0) {
+        _delay(MFM_SIM_LAT_CMD);
+        snprintf(buf, sizeof(buf), "?CAL,%u", sim.cal_points);
+        _emit(generation, buf);
+    } else if (strcmp(line, "Cal,clear") == 0) {
+        _delay(MFM_SIM_LAT_CMD);
+        sim.cal_gain_ppm = SIM_UNITY_PPM;
+        sim.cal_points   = 0;
+    } else if (strcmp(line, "Cal,dry") == 0) {
+        _delay(MFM_SIM_LAT_CAL);
+    } else if (strncmp(line, "Cal,", 4) == 0) {
+        _delay(MFM_SIM_LAT_CAL);
+        sim.cal_gain_ppm = sim.gain_ppm[sim.probe];
+        sim.cal_points   = (strncmp(line, "Cal,high,", 9) == 0) ? 2 : 1;
+    } else if (strcmp(line, "Export") == 0) {
+        _delay(MFM_SIM_LAT_EXPORT);
+        if (sim.export_line < SIM_CAL_LINES) {
+            _cal_line(buf, sim.cal_gain_ppm, sim.export_line++);
+            _emit(generation, buf);
+        } else {
+            sim.export_line = 0;
+            _emit(generation, "*DONE");
+        }
+    } else if (strncmp(line, "Import,", 7) == 0) {
+        _delay(MFM_SIM_LAT_IMPORT);
+        strncpy(sim.import_buf[sim.import_line], line + 7, SIM_CAL_LINE);
+        sim.import_buf[sim.import_line][SIM_CAL_LINE] = 0;
+        if (++sim.import_line == SIM_CAL_LINES) {
+            sim.import_line = 0;
+            if (_cal_decode() < 0) {
+                _emit(generation, "*ER");
+                return;
+            }
+            _emit(generation, "*OK");
+            _reboot(generation);
+            return;
+        }
+    } else if (strncmp(line, "C,", 2) == 0) {
+        _delay(MFM_SIM_LAT_CMD);
+        sim.continuous = (line[2] != '0');
+        if (sim.continuous) {
+            _stream_arm(generation);
+        }
+    } else if (strncmp(line, "L,", 2) == 0) {
+        _delay(MFM_SIM_LAT_CMD);
+    } else if (strncmp(line, "Baud,", 5) == 0) {
+        _delay(MFM_SIM_LAT_CMD);
+        _emit(generation, "*OK");
+        sim.baud = strtoul(line + 5, NULL, 10);
+        _reboot(generation);
+        return;
+    } else if (strcmp(line, "Factory") == 0) {
+        _delay(MFM_SIM_LAT_CMD);
+        _emit(generation, "*OK");
+        sim.cal_gain_ppm = SIM_UNITY_PPM;
+        sim.cal_points   = 0;
+        sim.k_value      = SIM_DEFAULT_K;
+        sim.continuous   = 1;
+        _reboot(generation);
+        return;
+    } else {
+        _delay(MFM_SIM_LAT_CMD);
+        _emit(generation, "*ER");
+        return;
+    }
+
+    _emit(generation, "*OK");
+}
+
+static void *_ezoec_sim_thread(void *arg) {
+    (void)arg;
+    msg_init_queue(_msg_queue, ARRAY_SIZE(_msg_queue));
+
+    msg_t msg;
+    for (;;) {
+        msg_receive(&msg);
+        uint32_t generation = msg.content.value;
+        switch (msg.type) {
+        case SIM_MSG_BOOT:
+            _delay(MFM_SIM_LAT_BOOT);
+            _emit(generation, "*RE");
+            if (sim.continuous) {
+                _stream_arm(generation);
+            }
+            break;
+        case SIM_MSG_STREAM:
+            // Dies with the power cycle or C,0
+            if (sim.powered && sim.continuous && generation == sim.generation) {
+                char buf[SIM_LINE_LEN];
+                _format_reading(buf, sizeof(buf), _reading_nS());
+                _emit(generation, buf);
+                _stream_arm(generation);
+            }
+            break;
+        case SIM_MSG_LINE: {
+            char line[SIM_LINE_LEN];
+            unsigned state = irq_disable();
+            memcpy(line, sim.queue[sim.queue_tail], SIM_LINE_LEN);
+            sim.queue_tail = (sim.queue_tail + 1) % SIM_LINE_QUEUE;
+            irq_restore(state);
+            if (sim.powered && generation == sim.generation && sim.host_baud == sim.baud) {
+                _handle_line(generation, line);
+            }
+        } break;
+        }
+    }
+    return NULL;
+}
+
+static void _post(uint16_t type) {
+    msg_t msg = {.type = type, .content.value = sim.generation};
+    if (msg_try_send(&msg, _pid) != 1) {
+        DEBUG("[ezoec_sim] queue full, dropping\n");
+    }
+}
+
+// ==================================
+// Public interface
+// ==================================
+
+void ezoec_sim_init(void) {
+    if (_pid != KERNEL_PID_UNDEF) {
+        return;
+    }
+    _pid = thread_create(_stack, sizeof(_stack), THREAD_PRIORITY_MAIN - 1, 0, _ezoec_sim_thread, NULL, "ezoec_sim");
+}
+
+int ezoec_sim_uart_init(uint32_t baud, uart_rx_cb_t rx_cb, void *arg) {
+    sim.host_baud = baud;
+    sim.rx_cb     = rx_cb;
+    sim.rx_arg    = arg;
+    sim.rx_len    = 0;
+    return 0;
+}
+
+void ezoec_sim_uart_write(const uint8_t *data, size_t len) {
+    if (!sim.powered) {
+        return;
+    }
+    while (len--) {
+        char c = (char)*data++;
+        if (c == '\0') {
+            continue;
+        }
+        if (c != '\r') {
+            if (sim.rx_len < SIM_LINE_LEN - 1) {
+                sim.rx_line[sim.rx_len++] = c;
+            }
+            continue;
+        }
+        sim.rx_line[sim.rx_len] = 0;
+        sim.rx_len              = 0;
+
+        unsigned state = irq_disable();
+        uint8_t next   = (sim.queue_head + 1) % SIM_LINE_QUEUE;
+        if (next == sim.queue_tail) {
+            irq_restore(state);
+            DEBUG("[ezoec_sim] line queue full, dropping\n");
+            continue;
+        }
+        memcpy(sim.queue[sim.queue_head], sim.rx_line, SIM_LINE_LEN);
+        sim.queue_head = next;
+        irq_restore(state);
+        _post(SIM_MSG_LINE);
+    }
+}
+
+void ezoec_sim_power(int on) {
+    if (on == sim.powered) {
+        return;
+    }
+    // A new generation invalidates everything still in flight.
+    sim.generation++;
+    sim.powered     = on;
+    sim.rx_len      = 0;
+    sim.import_line = 0;
+    sim.export_line = 0;
+    if (on) {
+        _post(SIM_MSG_BOOT);
+    }
+}
+
+void ezoec_sim_select_probe(uint8_t probe) { sim.probe = probe % MFM_SIM_PROBES; }
+
+void ezoec_sim_set_latency(mfm_sim_latency_t which, uint32_t ms) {
+    if (which < MFM_SIM_LAT_NUMOF) {
+        sim.latency[which] = ms;
+    }
+}
+
+uint32_t ezoec_sim_get_latency(mfm_sim_latency_t which) {
+    return (which < MFM_SIM_LAT_NUMOF) ? sim.latency[which] : 0;
+}
+
+int ezoec_sim_latency_from_name(const char *name) {
+    for (unsigned i = 0; i < MFM_SIM_LAT_NUMOF; i++) {
+        if (strcmp(name, latency_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void ezoec_sim_set_conductivity(uint8_t probe, uint32_t nS) { sim.conductivity_nS[probe % MFM_SIM_PROBES] = nS; }
+
+void ezoec_sim_set_gain(uint8_t probe, uint32_t ppm) {
+    if (ppm > 0) {
+        sim.gain_ppm[probe % MFM_SIM_PROBES] = ppm;
+    }
+}
+
+void ezoec_sim_set_noise(uint32_t nS) { sim.noise_nS = nS; }
+
+void ezoec_sim_print(void) {
+    printf("EZO-EC: %s, baud %" PRIu32 " (host %" PRIu32 "), probe %c, K %u.%u, cal gain %" PRIu32 " ppm\n",
+           sim.powered ? "on" : "off", sim.baud, sim.host_baud, 'A' + sim.probe, sim.k_value / 10, sim.k_value % 10,
+           sim.cal_gain_ppm);
+    for (unsigned p = 0; p < MFM_SIM_PROBES; p++) {
+        printf("  probe %c: %" PRIu32 " nS, gain %" PRIu32 " ppm\n", 'A' + p, sim.conductivity_nS[p], sim.gain_ppm[p]);
+    }
+    printf("  compensation: %" PRId32 " cC\n", sim.temp_cC);
+    printf("  noise: +/-%" PRIu32 " nS\n  latency (ms):", sim.noise_nS);
+    for (unsigned i = 0; i < MFM_SIM_LAT_NUMOF; i++) {
+        printf(" %s=%" PRIu32, latency_names[i], sim.latency[i]);
+    }
+    puts("");
+}
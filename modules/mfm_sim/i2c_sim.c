@@ -0,0 +1,112 @@
+/*
+ * MFM master for the host-native build.
+ *
+ * Native has no I2C slave peripheral, so the slave registration API from the
+ * RIOT i2c-slave patch is provided here and transactions are played against
+ * the registered prepare/finish callbacks exactly like the I2C1 ISR does:
+ * prepare on the address phase, data streamed from/into the returned buffer,
+ * finish on STOP. Callbacks run with IRQs masked to mimic ISR context.
+ */
+#include "irq.h"
+#include "mfm_sim.h"
+#include "periph/i2c.h"
+#include <string.h>
+#include <sys/errno.h>
+
+#define ENABLE_DEBUG 0
+#include "debug.h"
+
+uint16_t calculateCRC_CCITT(uint8_t *data, int length);
+
+#if !IS_USED(MODULE_PERIPH_I2C)
+i2c_slave_fsm_t *i2c_slave_fsm = NULL;
+
+void i2c_slave_reset_fsm(i2c_slave_fsm_t *fsm) {
+    fsm->state = I2C_SLAVE_STATE_IDLE;
+    fsm->data  = NULL;
+    fsm->len   = 0;
+    fsm->index = 0;
+}
+
+void i2c_slave_reg_clear(void) { i2c_slave_fsm = NULL; }
+
+void i2c_slave_reg(i2c_slave_fsm_t *fsm, i2c_salve_prepare_callback_t prepare, i2c_salve_finish_callback_t finish,
+                   uint8_t flags, void *arg) {
+    i2c_slave_reset_fsm(fsm);
+    fsm->prepare  = prepare;
+    fsm->finish   = finish;
+    fsm->flags    = flags;
+    fsm->arg      = arg;
+    i2c_slave_fsm = fsm;
+}
+
+void i2c_set_addr(i2c_t dev, uint16_t addr, uint16_t addr2, uint8_t mask) {
+    (void)dev;
+    (void)addr;
+    (void)addr2;
+    (void)mask;
+}
+#endif
+
+int mfm_sim_i2c_read(uint16_t reg, uint8_t *buf, size_t len) {
+    i2c_slave_fsm_t *fsm = i2c_slave_fsm;
+    if (fsm == NULL) {
+        return -ENODEV;
+    }
+
+    unsigned state = irq_disable();
+    fsm->reg_addr  = reg;
+    uint8_t *data  = NULL;
+    size_t avail   = fsm->prepare(1, MFM_SIM_I2C_SLAVE_ADR, reg, &data, fsm->arg);
+    if (avail == 0 || data == NULL) {
+        // The slave NACKs, the master sees nothing.
+        irq_restore(state);
+        return -EIO;
+    }
+    if (len > avail) {
+        len = avail;
+    }
+    memcpy(buf, data, len);
+    if (fsm->finish != NULL) {
+        fsm->finish(1, MFM_SIM_I2C_SLAVE_ADR, reg, len, fsm->arg);
+    }
+    irq_restore(state);
+    return len;
+}
+
+int mfm_sim_i2c_write(uint16_t reg, const uint8_t *data, size_t len) {
+    i2c_slave_fsm_t *fsm = i2c_slave_fsm;
+    if (fsm == NULL) {
+        return -ENODEV;
+    }
+
+    // Frame as the master does: CRC over register id and payload.
+    uint8_t frame[1 + 32 + 2];
+    if (len > 32) {
+        return -EMSGSIZE;
+    }
+    frame[0] = reg;
+    memcpy(&frame[1], data, len);
+    uint16_t crc       = calculateCRC_CCITT(frame, len + 1);
+    frame[len + 1]     = crc >> 8;
+    frame[len + 2]     = crc & 0xFF;
+    size_t payload_len = len + 2;
+
+    unsigned state = irq_disable();
+    fsm->reg_addr  = reg;
+    uint8_t *dst   = NULL;
+    size_t avail   = fsm->prepare(0, MFM_SIM_I2C_SLAVE_ADR, reg, &dst, fsm->arg);
+    if (avail == 0 || dst == NULL) {
+        irq_restore(state);
+        return -EIO;
+    }
+    if (payload_len > avail) {
+        payload_len = avail;
+    }
+    memcpy(dst, &frame[1], payload_len);
+    if (fsm->finish != NULL) {
+        fsm->finish(0, MFM_SIM_I2C_SLAVE_ADR, reg, payload_len, fsm->arg);
+    }
+    irq_restore(state);
+    return len;
+}
@@ -0,0 +1,82 @@
+#ifndef MFM_SIM_H
+#define MFM_SIM_H
+
+#include "periph/gpio.h"
+#include "periph/uart.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Host-native stand-ins for the ec-module board pins. They only serve as keys
+// for the simulated peers, nothing is driven on the host.
+#ifndef PRB_SEL_PIN
+#define PRB_SEL_PIN GPIO_PIN(0, 6)
+#endif
+#ifndef DQ_A_PIN
+#define DQ_A_PIN GPIO_PIN(0, 5)
+#endif
+#ifndef DQ_B_PIN
+#define DQ_B_PIN GPIO_PIN(0, 7)
+#endif
+#ifndef BOOST_EN_PIN
+#define BOOST_EN_PIN GPIO_PIN(1, 12)
+#endif
+
+#define MFM_SIM_PROBES        2
+#define MFM_SIM_DS18_DEVICES  4
+#define MFM_SIM_I2C_SLAVE_ADR 0x11
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    MFM_SIM_LAT_BOOT,   // Power-up until the *RE banner
+    MFM_SIM_LAT_CMD,    // Plain commands (K, C, L, i, ...)
+    MFM_SIM_LAT_READ,   // R
+    MFM_SIM_LAT_CAL,    // Cal,dry / Cal,low / Cal,high
+    MFM_SIM_LAT_IMPORT, // Each Import, line
+    MFM_SIM_LAT_EXPORT, // Each Export line
+    MFM_SIM_LAT_RESET,  // Reboot after import/factory until *RE
+    MFM_SIM_LAT_NUMOF,
+} mfm_sim_latency_t;
+
+void mfm_sim_init(void);
+int mfm_sim_cmd(int argc, char **argv);
+
+// Board level hooks
+void mfm_sim_boost(int on);
+void mfm_sim_probe_select(uint8_t probe);
+
+// EZO-EC on LPUART1
+void ezoec_sim_init(void);
+void ezoec_sim_power(int on);
+void ezoec_sim_select_probe(uint8_t probe);
+int ezoec_sim_latency_from_name(const char *name);
+int ezoec_sim_uart_init(uint32_t baud, uart_rx_cb_t rx_cb, void *arg);
+void ezoec_sim_uart_write(const uint8_t *data, size_t len);
+void ezoec_sim_set_latency(mfm_sim_latency_t which, uint32_t ms);
+uint32_t ezoec_sim_get_latency(mfm_sim_latency_t which);
+void ezoec_sim_set_conductivity(uint8_t probe, uint32_t nS);
+void ezoec_sim_set_gain(uint8_t probe, uint32_t ppm);
+void ezoec_sim_set_noise(uint32_t nS);
+void ezoec_sim_print(void);
+
+// DS18B20s on the 1-Wire pins
+int ds18_sim_add(gpio_t pin, const uint8_t rom[8], int16_t centi_C);
+int ds18_sim_set_temperature(gpio_t pin, unsigned index, int16_t centi_C);
+void ds18_sim_set_conversion_time(uint32_t ms);
+int ds18_sim_glitch(gpio_t pin, unsigned reads);
+int ds18_sim_reset(gpio_t pin);
+void ds18_sim_write_bit(gpio_t pin, uint8_t bit);
+uint8_t ds18_sim_read_bit(gpio_t pin);
+void ds18_sim_print(void);
+
+// MFM master on the I2C slave
+int mfm_sim_i2c_read(uint16_t reg, uint8_t *buf, size_t len);
+int mfm_sim_i2c_write(uint16_t reg, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* end of include guard: MFM_SIM_H */
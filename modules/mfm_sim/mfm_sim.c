@@ -0,0 +1,145 @@
+#include "mfm_sim.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const uint8_t rom_a[8] = {0x28, 0xA1, 0x3C, 0x46, 0x0D, 0x00, 0x00};
+static const uint8_t rom_b[8] = {0x28, 0xB2, 0x7E, 0x51, 0x0D, 0x00, 0x00};
+
+void mfm_sim_init(void) {
+    ds18_sim_add(DQ_A_PIN, rom_a, 2150);
+    ds18_sim_add(DQ_B_PIN, rom_b, 2225);
+    ezoec_sim_init();
+}
+
+void mfm_sim_boost(int on) { ezoec_sim_power(on); }
+
+void mfm_sim_probe_select(uint8_t probe) { ezoec_sim_select_probe(probe); }
+
+static int _probe(const char *arg) {
+    if (arg[0] == 'a' || arg[0] == 'A')
+        return 0;
+    if (arg[0] == 'b' || arg[0] == 'B')
+        return 1;
+    return -1;
+}
+
+static void _usage(void) {
+    puts("Usage: sim <command>\n"
+         "  status                  Show the state of all simulated peers\n"
+         "  lat <name> <ms>         Set an EZO latency (boot cmd read cal import export reset)\n"
+         "  ec <A|B> <nS>           Set the true conductivity seen by a probe\n"
+         "  gain <A|B> <ppm>        Set the cell gain of a probe (1000000 = ideal)\n"
+         "  noise <nS>              Set +/- reading noise\n"
+         "  temp <A|B> <cC> [idx]   Set a DS18B20 temperature in centi-degrees\n"
+         "  ds18 <A|B> <cC>         Add another DS18B20 to a probe's bus\n"
+         "  glitch <A|B> <n>        Corrupt the next n scratchpad reads of a bus\n"
+         "  conv <ms>               Set the DS18B20 12-bit conversion time\n"
+         "  i2c r <reg> [len]       MFM master read (hex reg)\n"
+         "  i2c w <reg> <byte>...   MFM master write, CRC is appended (hex)");
+}
+
+static int _cmd_i2c(int argc, char **argv) {
+    if (argc < 3) {
+        _usage();
+        return -1;
+    }
+    uint16_t reg = strtoul(argv[2], NULL, 16);
+    if (argv[1][0] == 'r') {
+        uint8_t buf[64];
+        size_t len = (argc >= 4) ? strtoul(argv[3], NULL, 0) : sizeof(buf);
+        if (len > sizeof(buf)) {
+            len = sizeof(buf);
+        }
+        int result = mfm_sim_i2c_read(reg, buf, len);
+        if (result < 0) {
+            printf("NACK (%d)\n", result);
+            return result;
+        }
+        for (int i = 0; i < result; i++) {
+            printf("%02X ", buf[i]);
+        }
+        puts("");
+        return 0;
+    }
+    if (argv[1][0] == 'w') {
+        uint8_t buf[32];
+        size_t len = 0;
+        for (int i = 3; i < argc && len < sizeof(buf); i++) {
+            buf[len++] = strtoul(argv[i], NULL, 16);
+        }
+        int result = mfm_sim_i2c_write(reg, buf, len);
+        if (result < 0) {
+            printf("NACK (%d)\n", result);
+            return result;
+        }
+        return 0;
+    }
+    _usage();
+    return -1;
+}
+
+int mfm_sim_cmd(int argc, char **argv) {
+    if (argc < 2) {
+        _usage();
+        return -1;
+    }
+
+    const char *cmd = argv[1];
+    if (strcmp(cmd, "status") == 0) {
+        ezoec_sim_print();
+        ds18_sim_print();
+        return 0;
+    }
+    if (strcmp(cmd, "i2c") == 0) {
+        return _cmd_i2c(argc - 1, argv + 1);
+    }
+    if (strcmp(cmd, "lat") == 0 && argc >= 4) {
+        int which = ezoec_sim_latency_from_name(argv[2]);
+        if (which < 0) {
+            _usage();
+            return -1;
+        }
+        ezoec_sim_set_latency(which, strtoul(argv[3], NULL, 0));
+        return 0;
+    }
+    if (strcmp(cmd, "noise") == 0 && argc >= 3) {
+        ezoec_sim_set_noise(strtoul(argv[2], NULL, 0));
+        return 0;
+    }
+    if (strcmp(cmd, "conv") == 0 && argc >= 3) {
+        ds18_sim_set_conversion_time(strtoul(argv[2], NULL, 0));
+        return 0;
+    }
+
+    int probe = (argc >= 4) ? _probe(argv[2]) : -1;
+    if (probe < 0) {
+        _usage();
+        return -1;
+    }
+    if (strcmp(cmd, "ec") == 0) {
+        ezoec_sim_set_conductivity(probe, strtoul(argv[3], NULL, 0));
+        return 0;
+    }
+    if (strcmp(cmd, "gain") == 0) {
+        ezoec_sim_set_gain(probe, strtoul(argv[3], NULL, 0));
+        return 0;
+    }
+    if (strcmp(cmd, "ds18") == 0) {
+        // Each added device takes the next serial, so their ROMs differ
+        static uint8_t serial = 0xC0;
+        const uint8_t rom[8]  = {0x28, serial++, 0x5A, 0x61, 0x0D, 0x00, 0x00};
+        return ds18_sim_add(probe == 0 ? DQ_A_PIN : DQ_B_PIN, rom, atoi(argv[3])) < 0 ? -1 : 0;
+    }
+    if (strcmp(cmd, "glitch") == 0) {
+        return ds18_sim_glitch(probe == 0 ? DQ_A_PIN : DQ_B_PIN, strtoul(argv[3], NULL, 0));
+    }
+    if (strcmp(cmd, "temp") == 0) {
+        unsigned index = (argc >= 5) ? strtoul(argv[4], NULL, 0) : 0;
+        return ds18_sim_set_temperature(probe == 0 ? DQ_A_PIN : DQ_B_PIN, index, atoi(argv[3]));
+    }
+
+    _usage();
+    return -1;
+}
@@ -0,0 +1,16 @@
+// Generated by modules/ezoec/gen_tc_lut.py --fixture from calibration.py, do not edit.
+#ifndef TC_REF_SOLUTIONS_H
+#define TC_REF_SOLUTIONS_H
+
+#include <stdint.h>
+
+// Reference solutions (uS/cm) over temperature (C)
+static const int16_t t_low[] = {5, 10, 15, 20, 25, 30, 35, 40, 45, 50};
+static const uint32_t c_low[] = {8220, 9330, 10480, 11670, 12880, 14120, 15550, 16880, 18210, 19550};
+static const int16_t t_high[] = {5, 10, 15, 20, 25, 30, 35, 40, 45, 50};
+static const uint32_t c_high[] = {53500, 59600, 65400, 72400, 80000, 88200, 96400, 104600, 112800, 121000};
+
+#define C_LOW_AT_25  12880
+#define C_HIGH_AT_25 80000
+
+#endif /* end of include guard: TC_REF_SOLUTIONS_H */
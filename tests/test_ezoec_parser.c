@@ -0,0 +1,101 @@
+// Host-side unit test for the EZO line reader in modules/ezoec/ezoec_parser.c
+//
+// Build & run with:
+//   cc -I../modules/ezoec/include test_ezoec_parser.c ../modules/ezoec/ezoec_parser.c && ./a.out
+#include "ezoec_parser.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Feeds @p text and returns the event of its last line, -1 if there was none
+static int feed(ezoec_parser_t *p, const char *text, ezoec_evt_t *evt) {
+    int got = -1;
+    for (; *text; text++) {
+        if (ezoec_parser_feed(p, (uint8_t)*text, evt)) {
+            got = evt->type;
+        }
+    }
+    return got;
+}
+
+#define CHECK_STATUS(text, expected)                                                                                   \
+    do {                                                                                                               \
+        ezoec_evt_t evt;                                                                                               \
+        int type = feed(&p, (text), &evt);                                                                             \
+        if (type != EZOEC_EVT_STATUS || evt.status != (expected)) {                                                    \
+            fprintf(stderr, "FAIL: \"%s\" -> type %d status %d, expected status %d\n", (text), type, evt.status,       \
+                    (expected));                                                                                       \
+            failures++;                                                                                                \
+        }                                                                                                              \
+    } while (0)
+
+#define CHECK_READING(text, expected)                                                                                  \
+    do {                                                                                                               \
+        ezoec_evt_t evt;                                                                                               \
+        int type = feed(&p, (text), &evt);                                                                             \
+        if (type != EZOEC_EVT_READING || evt.value != (expected)) {                                                    \
+            fprintf(stderr, "FAIL: \"%s\" -> type %d value %lu, expected %lu\n", (text), type,                         \
+                    (unsigned long)evt.value, (unsigned long)(expected));                                              \
+            failures++;                                                                                                \
+        }                                                                                                              \
+    } while (0)
+
+#define CHECK_LINE(text)                                                                                               \
+    do {                                                                                                               \
+        ezoec_evt_t evt;                                                                                               \
+        int type = feed(&p, (text), &evt);                                                                             \
+        if (type != EZOEC_EVT_LINE) {                                                                                  \
+            fprintf(stderr, "FAIL: \"%s\" -> type %d, expected a plain line\n", (text), type);                         \
+            failures++;                                                                                                \
+        }                                                                                                              \
+    } while (0)
+
+int main(void) {
+    int failures = 0;
+    ezoec_parser_t p;
+    ezoec_parser_set_line(&p, NULL, 0);
+    ezoec_parser_reset(&p);
+
+    CHECK_STATUS("*OK\r", EZOEC_STATUS_OK);
+    CHECK_STATUS("*ER\r", EZOEC_STATUS_ERROR);
+    CHECK_STATUS("*RE\r", EZOEC_STATUS_READY);
+    CHECK_STATUS("*DONE\r", EZOEC_STATUS_DONE);
+    CHECK_STATUS("*OKAY\r", EZOEC_STATUS_UNKNOWN);
+    // Empty lines and stray line feeds produce no event
+    CHECK_STATUS("\r\n*WA\r", EZOEC_STATUS_WAKE);
+
+    // Readings in nS, first field only, digits beyond 1 nS truncated
+    CHECK_READING("1413.27\r", 1413270);
+    CHECK_READING("12880,6440\r", 12880000);
+    CHECK_READING("0.071\r", 71);
+    CHECK_READING("0.0715\r", 71);
+    CHECK_READING(".5\r", 500);
+    CHECK_READING("4294967\r", 4294967000);
+
+    CHECK_LINE("?I,EC,2.16\r");
+    CHECK_LINE("5A3F00C8E112\r");
+    CHECK_LINE("1.2.3\r");
+    CHECK_LINE("12a\r");
+    // Would wrap 32 bits, garbled lines must not turn into plausible readings
+    CHECK_LINE("4294968\r");
+    CHECK_LINE("99999999999\r");
+    CHECK_LINE("1234567890123456789012345678901234567890123456789\r");
+
+    // Raw lines copied into a sink, truncated to its size
+    char sink[12];
+    ezoec_evt_t evt;
+    ezoec_parser_set_line(&p, sink, sizeof(sink));
+    if (feed(&p, "0012A0FF3B4C99\r", &evt) != EZOEC_EVT_LINE || evt.len != sizeof(sink) || !evt.truncated ||
+        memcmp(sink, "0012A0FF3B4C", sizeof(sink)) != 0) {
+        fprintf(stderr, "FAIL: sink got \"%.12s\" len %u truncated %u\n", sink, evt.len, evt.truncated);
+        failures++;
+    }
+    ezoec_parser_set_line(&p, NULL, 0);
+
+    if (failures == 0) {
+        puts("OK: all ezoec_parser cases passed");
+        return 0;
+    }
+    fprintf(stderr, "%d failure(s)\n", failures);
+    return 1;
+}
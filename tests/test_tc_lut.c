@@ -0,0 +1,52 @@
+// Host-side unit test for ezoec_tc_normalise from modules/ezoec/ezoec_tc.c
+//
+// Normalises the reference solution tables of calibration.py and checks that
+// every point lands on the 25 C value of its solution. The tables come in
+// through tc_ref_solutions.h, generated from calibration.py with
+// gen_tc_lut.py --fixture like the firmware's table.
+//
+// Build & run with:
+//   cc -I../modules/ezoec/include -I../modules/ezoec test_tc_lut.c ../modules/ezoec/ezoec_tc.c && ./a.out
+#include "ezoec_tc.h"
+#include "tc_ref_solutions.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define TOLERANCE_PERMILLE 10
+
+static int check(const int16_t *t_ref, const uint32_t *c, unsigned len, uint32_t at_25) {
+    int failed = 0;
+    for (unsigned i = 0; i < len; i++) {
+        uint32_t got = ezoec_tc_normalise(c[i] * 1000, t_ref[i] * 100) / 1000;
+        uint32_t err = got > at_25 ? got - at_25 : at_25 - got;
+        if (err * 1000 > at_25 * TOLERANCE_PERMILLE) {
+            printf("FAIL: %u uS at %d C -> %u uS, expected %u\n", (unsigned)c[i], t_ref[i], (unsigned)got,
+                   (unsigned)at_25);
+            failed++;
+        }
+    }
+    return failed;
+}
+
+int main(void) {
+    int failed = check(t_low, c_low, sizeof(c_low) / sizeof(c_low[0]), C_LOW_AT_25) +
+                 check(t_high, c_high, sizeof(c_high) / sizeof(c_high[0]), C_HIGH_AT_25);
+
+    // Clamped outside of the table
+    if (ezoec_tc_normalise(12880000, -500) != ezoec_tc_normalise(12880000, 0) ||
+        ezoec_tc_normalise(12880000, 6000) != ezoec_tc_normalise(12880000, 5000)) {
+        puts("FAIL: temperature is not clamped to the table");
+        failed++;
+    }
+    if (ezoec_tc_normalise(12880000, 2500) != 12880000) {
+        puts("FAIL: 25 C is not the identity");
+        failed++;
+    }
+
+    if (failed) {
+        printf("%d checks failed\n", failed);
+        return 1;
+    }
+    puts("OK: reference solutions normalise to 25 C");
+    return 0;
+}